@@ -20,9 +20,116 @@
 #include <fstream>
 #include <vector>
 #include <random>
+#include <string>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <ctime>
+#include <csignal>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#endif
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 typedef unsigned long long int vlong;
 
+// Functions exported for MatrixMult22.py to load the solver as a library.
+#ifdef _WIN32
+#define FGEXPORT extern "C" __declspec(dllexport)
+#else
+#define FGEXPORT extern "C"
+#endif
+
+// Memory arena for the large arrays of a walk, one mapping advised to use 2 MB pages so the random accesses
+// into the dictionaries need fewer TLB entries.  Mode 0 leaves allocation to new, 1 uses transparent huge
+// pages and 2 explicit huge pages, falling back to transparent ones if none are reserved.  The pages are
+// first touched by the thread constructing the walk, so with pinned threads they are local to its CPU.
+class fgarena {
+public:
+    char* base;
+    char* map;
+    size_t size, used, mapsize;
+
+    // Constructor, maps n bytes rounded up to whole huge pages in the given mode, leaves base NULL if not in use.
+    fgarena(size_t n, int mode) {
+        base = NULL;
+        map = NULL;
+        size = 0;
+        used = 0;
+        mapsize = 0;
+#ifndef _WIN32
+        const size_t huge = 2097152;
+        if (mode > 0) {
+            size = (n + huge - 1) / huge * huge;
+#ifdef MAP_HUGETLB
+            if (mode == 2) {
+                void* p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+                if (p != MAP_FAILED) {
+                    map = (char*)p;
+                    mapsize = size;
+                    base = map;
+                }
+            }
+#endif
+            if (base == NULL) {
+                void* p = mmap(NULL, size + huge, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                if (p != MAP_FAILED) {
+                    map = (char*)p;
+                    mapsize = size + huge;
+                    base = map + (huge - (size_t)map % huge) % huge;
+#ifdef MADV_HUGEPAGE
+                    madvise(base, size, MADV_HUGEPAGE);
+#endif
+                }
+            }
+        }
+#endif
+    }
+
+    // Destructor.
+    ~fgarena() {
+#ifndef _WIN32
+        if (map != NULL) {
+            munmap(map, mapsize);
+        }
+#endif
+    }
+
+    // Take n bytes aligned to a cache line, NULL if the arena is not in use or full.
+    void* take(size_t n) {
+        if (base == NULL || used + n > size) {
+            return NULL;
+        }
+        void* p = base + used;
+        used += (n + 63) / 64 * 64;
+        return p;
+    }
+};
+
 // Bespoke dictionary data structure class for flip graph.
 class fgdict {
 public:
@@ -30,13 +137,25 @@ public:
     int* count;
     vlong* key;
     int* value;
+    bool owned;
 
-    // Constructor.
-    fgdict() {
+    // Bytes taken from an arena.
+    static const size_t arenabytes = 1048576 * (2 * sizeof(int) + sizeof(vlong)) + 192;
+
+    // Constructor, arrays come from the arena if one is given and in use.
+    fgdict(fgarena* arena = NULL) {
         lasthash = 0;
-        count = new int[1048576];
-        key = new vlong[1048576];
-        value = new int[1048576];
+        owned = arena == NULL || arena->base == NULL;
+        if (owned) {
+            count = new int[1048576];
+            key = new vlong[1048576];
+            value = new int[1048576];
+        }
+        else {
+            count = (int*)arena->take(1048576 * sizeof(int));
+            key = (vlong*)arena->take(1048576 * sizeof(vlong));
+            value = (int*)arena->take(1048576 * sizeof(int));
+        }
         for (int i = 0; i < 65536; i++) {
             count[i << 4] = 0;
         }
@@ -44,7 +163,11 @@ public:
 
     // Destructor.
     ~fgdict() {
-        delete[] count, key, value;
+        if (owned) {
+            delete[] count;
+            delete[] key;
+            delete[] value;
+        }
     }
 
     // Calculate size of dictionary.
@@ -294,6 +417,34 @@ inline int bitcount(vlong var) {
     return c;
 }
 
+// Returns index of the lowest set bit, var non-zero.
+inline int lowbit(vlong var) {
+    static const int debruijn[64] = {
+        0, 1, 48, 2, 57, 49, 28, 3, 61, 58, 50, 42, 38, 29, 17, 4, 62, 55, 59, 36, 53, 51, 43, 22, 45, 39, 33, 30, 24, 18, 12, 5,
+        63, 47, 56, 27, 60, 41, 37, 16, 54, 35, 52, 21, 44, 32, 23, 11, 46, 26, 40, 15, 34, 20, 31, 10, 25, 14, 19, 9, 13, 8, 7, 6
+    };
+    return debruijn[((var & (0 - var)) * 0x03F79D71B4CB0A89ULL) >> 58];
+}
+
+// Mixing function for state hashes, the same for every walk so hashes can be compared across runs.
+inline vlong mixhash(vlong x) {
+    x ^= x >> 31;
+    x *= 0x7FB5D329728EA185ULL;
+    x ^= x >> 27;
+    x *= 0x81DADEF4BC2DD44DULL;
+    x ^= x >> 33;
+    return x;
+}
+
+// Seed of the random stream for a run, walker and restart of a campaign with the given master seed.
+// Counter based, each seed depends only on its indices, not on thread count, scheduling or library.
+inline int streamseed(vlong master, vlong run, vlong walker, vlong restart) {
+    vlong x = mixhash(master + 0x9E3779B97F4A7C15ULL);
+    x = mixhash(x ^ run);
+    x = mixhash(x ^ (walker << 32 | (restart & 0xFFFFFFFF)));
+    return (int)(x >> 33);
+}
+
 // Returns non-zero (true) if number of set bits < exceed, else zero (false).
 inline int bitlimit(vlong var, int exceed) {
     int m = exceed;
@@ -332,901 +483,4936 @@ vlong updatelimit(vlong limit, vlong flips, int termination, int split, int achi
     return rlimit;
 }
 
-// C++ implementation of original Python solver function.
-int main(int argc, char* argv[]) {
 
-    std::ifstream input_file(argv[1]);
-    vlong flips, flimit, plimit;
-    int nomuls, rcode, target, rseed, symm, achieved, maxplus, minmuls, maxsize, termination, split;
-    input_file >> nomuls >> flips >> rcode >> target >> flimit >> plimit >> termination >> rseed >> symm >> maxplus >> split >> minmuls >> maxsize;
+// Elite pool shared by walkers, the lowest rank schemes found so far, distinct by state hash.
+// Schemes are only published at a new lowest rank for a walker, so a single lock is rarely contended.
+class fgpool {
+public:
+    std::mutex lock;
+    std::atomic<int> worst;
+    int capacity;
+    std::vector<std::vector<vlong>> schemes;
+    std::vector<int> ranks;
+    std::vector<vlong> hashes;
+    std::vector<int> uses;
 
-    std::vector<vlong> muls;
-    std::vector<vlong> best;
-    for (int i = 0; i < nomuls; i++) {
-        vlong m;
-        input_file >> m;
-        muls.push_back(m);
-        best.push_back(m);
+    // Constructor.
+    fgpool(int c) {
+        capacity = c;
+        worst = 1 << 30;
+    }
+
+    // Offer a scheme, kept if the pool has room or it beats the worst member, returns non-zero if kept.
+    int publish(const std::vector<vlong>& m, int rank, vlong h) {
+        if (rank >= worst.load(std::memory_order_relaxed)) {
+            return 0;
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        for (size_t i = 0; i < hashes.size(); i++) {
+            if (hashes[i] == h && ranks[i] == rank) {
+                return 0;
+            }
+        }
+        int w = 0;
+        if (schemes.size() < (size_t)capacity) {
+            schemes.push_back(m);
+            ranks.push_back(rank);
+            hashes.push_back(h);
+            uses.push_back(0);
+        }
+        else {
+            for (int i = 1; i < (int)ranks.size(); i++) {
+                if (ranks[i] > ranks[w] || (ranks[i] == ranks[w] && uses[i] > uses[w])) {
+                    w = i;
+                }
+            }
+            if (rank >= ranks[w]) {
+                return 0;
+            }
+            schemes[w] = m;
+            ranks[w] = rank;
+            hashes[w] = h;
+            uses[w] = 0;
+        }
+        if (schemes.size() == (size_t)capacity) {
+            w = ranks[0];
+            for (int r : ranks) {
+                if (r > w) {
+                    w = r;
+                }
+            }
+            worst = w + 1;
+        }
+        return 1;
+    }
+
+    // Pick a scheme to restart from, weighted to low rank and little used members, returns zero if empty.
+    // Each rank step of symm above the best halves the weight, as does each earlier restart from the member.
+    int sample(std::vector<vlong>& m, int symm, std::mt19937& mt) {
+        std::lock_guard<std::mutex> guard(lock);
+        if (schemes.size() == 0) {
+            return 0;
+        }
+        int b = ranks[0];
+        for (int r : ranks) {
+            if (r < b) {
+                b = r;
+            }
+        }
+        std::vector<double> weights;
+        double total = 0;
+        for (int i = 0; i < (int)schemes.size(); i++) {
+            int e = (ranks[i] - b) / symm + uses[i];
+            double x = 1.0 / (1 << (e < 30 ? e : 30));
+            weights.push_back(x);
+            total += x;
+        }
+        double x = total * (mt() / 4294967296.0);
+        int i = 0;
+        while (i < (int)weights.size() - 1 && x >= weights[i]) {
+            x -= weights[i];
+            i++;
+        }
+        uses[i]++;
+        m = schemes[i];
+        return 1;
+    }
+};
+
+// Scheme pool in memory shared by solver processes on a node, one segment per problem, set up by the first to open it.
+// Slots hold the nonzero symmetry groups of a scheme, each slot guarded by a sequence number that is odd while written.
+// Writers take a slot with a compare and swap and give up if it is busy, readers retry if the number moved while copying.
+class fgshared {
+public:
+    struct header {
+        std::atomic<unsigned int> state;
+        unsigned int capacity;
+        unsigned int slotmuls;
+        vlong key;
+    };
+    struct slot {
+        std::atomic<unsigned int> seq;
+        std::atomic<int> rank;
+        std::atomic<int> uses;
+        int count;
+        std::atomic<vlong> hash;
+    };
+    static_assert(std::atomic<unsigned int>::is_always_lock_free, "shared pool needs lock free atomics");
+    static_assert(std::atomic<int>::is_always_lock_free, "shared pool needs lock free atomics");
+    static_assert(std::atomic<vlong>::is_always_lock_free, "shared pool needs lock free atomics");
+
+    char* base;
+    size_t bytes;
+    int capacity, slotmuls, symm;
+    header* head;
+
+    // Constructor, the pool is unusable until opened.
+    fgshared() {
+        base = NULL;
+        bytes = 0;
+        head = NULL;
     }
 
-    std::vector<int> me(nomuls, 0);
-    std::vector<int> mf(nomuls, 0);
-    for (int i = 0; i < nomuls; i += 3) {
-        me[i] = i + 2;
-        mf[i] = i + 1;
-        me[i + 1] = i;
-        mf[i + 1] = i + 2;
-        me[i + 2] = i + 1;
-        mf[i + 2] = i;
+    // Destructor, unmaps the segment but leaves it for other processes.
+    ~fgshared() {
+#ifndef _WIN32
+        if (base != NULL) {
+            munmap(base, bytes);
+        }
+#endif
     }
 
-    std::mt19937 mt(rseed);
+    // Slot i of the segment.
+    inline slot* at(int i) {
+        return (slot*)(base + sizeof(header) + i * (sizeof(slot) + slotmuls * sizeof(vlong)));
+    }
 
-    fgdict uniques;
-    int* unarray = new int[nomuls * (nomuls + 1)];
-    std::vector<int> avail;
-    for (int i = 0; i < nomuls; i++) {
-        int b = i * (nomuls + 1);
-        avail.push_back(b);
+    // Multiplications held in slot i.
+    inline vlong* data(int i) {
+        return (vlong*)((char*)at(i) + sizeof(slot));
     }
-    fgdict twoplusd;
-    std::vector<vlong> twoplusl;
 
-    std::vector<std::vector<int>> permit;
-    permit.reserve(nomuls);
-    for (int i = 0; i < nomuls; i++) {
-        std::vector<int> p;
-        p.reserve(nomuls);
-        for (int j = 0; j < nomuls; j++) {
-            if (i / symm == j / symm) {
-                p.push_back(0);
+    // Open or create the segment for a problem, shm_open first and a file in the temporary directory if that fails,
+    // readable and writable by the user only.  Returns non-zero if the pool can be used.
+    int open(const std::string& name, vlong key, int sy, int sm, int cap) {
+#ifdef _WIN32
+        std::cerr << "Shared scheme pool is not available on this platform.\n";
+        return 0;
+#else
+        if (name.empty() || name.find_first_not_of("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") != std::string::npos) {
+            std::cerr << "Shared scheme pool name " << name << " may only contain letters, digits, '-' and '_'.\n";
+            return 0;
+        }
+        symm = sy;
+        capacity = cap;
+        slotmuls = sm;
+        char tag[64];
+        snprintf(tag, sizeof(tag), "-%016llx-%d-%d", key, symm, slotmuls);
+        std::string sname = "/fgpool-" + name + tag;
+        bytes = sizeof(header) + capacity * (sizeof(slot) + slotmuls * sizeof(vlong));
+        int fd = shm_open(sname.c_str(), O_CREAT | O_RDWR, 0600);
+        if (fd < 0) {
+            const char* tmp = getenv("TMPDIR");
+            std::string fname = std::string(tmp != NULL ? tmp : "/tmp") + sname;
+            fd = ::open(fname.c_str(), O_CREAT | O_RDWR, 0600);
+        }
+        if (fd < 0) {
+            return 0;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || (st.st_size != 0 && st.st_size != (off_t)bytes) || (st.st_size == 0 && ftruncate(fd, bytes) != 0)) {
+            close(fd);
+            return 0;
+        }
+        void* p = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (p == MAP_FAILED) {
+            return 0;
+        }
+        base = (char*)p;
+        head = (header*)base;
+        unsigned int zero = 0;
+        if (head->state.compare_exchange_strong(zero, 1)) {
+            head->capacity = capacity;
+            head->slotmuls = slotmuls;
+            head->key = key;
+            head->state.store(2, std::memory_order_release);
+        }
+        for (int i = 0; i < 100000 && head->state.load(std::memory_order_acquire) != 2; i++) {
+            std::this_thread::yield();
+        }
+        if (head->state.load(std::memory_order_acquire) != 2 || head->capacity != (unsigned int)capacity || head->slotmuls != (unsigned int)slotmuls || head->key != key) {
+            munmap(base, bytes);
+            base = NULL;
+            return 0;
+        }
+        return 1;
+#endif
+    }
+
+    // Offer a scheme, stored over an empty or the worst slot if it is better, returns non-zero if stored.
+    int publish(const std::vector<vlong>& m, int rank, vlong h) {
+        std::vector<vlong> c;
+        for (int i = 0; i < (int)m.size(); i += symm) {
+            vlong x = 0;
+            for (int j = i; j < i + symm; j++) {
+                x |= m[j];
             }
-            else {
-                p.push_back(1);
+            if (x != 0) {
+                c.insert(c.end(), m.begin() + i, m.begin() + i + symm);
             }
         }
-        permit.push_back(p);
+        if (c.size() > (size_t)slotmuls) {
+            return 0;
+        }
+        int w = 0;
+        int wr = -1;
+        for (int i = 0; i < capacity; i++) {
+            slot* s = at(i);
+            int r = s->rank.load(std::memory_order_relaxed);
+            if (r == rank && s->hash.load(std::memory_order_relaxed) == h) {
+                return 0;
+            }
+            if (r == 0) {
+                r = 1 << 30;
+            }
+            if (r > wr) {
+                w = i;
+                wr = r;
+            }
+        }
+        if (rank >= wr) {
+            return 0;
+        }
+        slot* s = at(w);
+        unsigned int q = s->seq.load(std::memory_order_relaxed);
+        if ((q & 1) || !s->seq.compare_exchange_strong(q, q + 1, std::memory_order_acquire)) {
+            return 0;
+        }
+        int r = s->rank.load(std::memory_order_relaxed);
+        if (r == 0 || rank < r) {
+            s->count = c.size();
+            s->hash.store(h, std::memory_order_relaxed);
+            memcpy(data(w), c.data(), c.size() * sizeof(vlong));
+            s->uses.store(0, std::memory_order_relaxed);
+            s->rank.store(rank, std::memory_order_relaxed);
+        }
+        s->seq.store(q + 2, std::memory_order_release);
+        return r == 0 || rank < r;
     }
 
-    achieved = 0;
-    for (int i = 0; i < nomuls; i++) {
-        vlong m = muls[i];
-        if (m > 0) {
-            if (uniques.contains(m)) {
-                int b = uniques.getvalue(m);
-                int l = unarray[b];
-                l++;
-                unarray[b + l] = i;
-                unarray[b] = l;
-                if (!twoplusd.contains(m)) {
-                    twoplusd.add(m, twoplusl.size());
-                    twoplusl.push_back(m);
+    // Copy a scheme into m for a restart, weighted to low rank and little used slots as for fgpool, returns zero if none.
+    int sample(std::vector<vlong>& m, std::mt19937& mt) {
+        std::vector<int> ranks(capacity);
+        int b = 0;
+        for (int i = 0; i < capacity; i++) {
+            ranks[i] = at(i)->rank.load(std::memory_order_relaxed);
+            if (ranks[i] != 0 && (b == 0 || ranks[i] < b)) {
+                b = ranks[i];
+            }
+        }
+        if (b == 0) {
+            return 0;
+        }
+        std::vector<double> weights(capacity, 0);
+        double total = 0;
+        for (int i = 0; i < capacity; i++) {
+            if (ranks[i] != 0) {
+                int e = (ranks[i] - b) / symm + at(i)->uses.load(std::memory_order_relaxed);
+                weights[i] = 1.0 / (1 << (e < 30 ? e : 30));
+                total += weights[i];
+            }
+        }
+        double x = total * (mt() / 4294967296.0);
+        int i = 0;
+        while (i < capacity - 1 && (weights[i] == 0 || x >= weights[i])) {
+            x -= weights[i];
+            i++;
+        }
+        slot* s = at(i);
+        std::vector<vlong> c(slotmuls);
+        for (int k = 0; k < 100; k++) {
+            unsigned int q = s->seq.load(std::memory_order_acquire);
+            if (q & 1) {
+                std::this_thread::yield();
+                continue;
+            }
+            int n = s->count;
+            if (n <= (int)m.size() && n <= slotmuls) {
+                memcpy(c.data(), data(i), n * sizeof(vlong));
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (s->seq.load(std::memory_order_relaxed) != q) {
+                continue;
+            }
+            if (s->rank.load(std::memory_order_relaxed) == 0 || n > (int)m.size()) {
+                return 0;
+            }
+            s->uses.fetch_add(1, std::memory_order_relaxed);
+            std::fill(m.begin(), m.end(), 0);
+            std::copy(c.begin(), c.begin() + n, m.begin());
+            return 1;
+        }
+        return 0;
+    }
+};
+
+// Live metrics of a solve for monitoring long runs.  Walks publish every gap flips, a few atomic stores, and a low
+// priority thread writes them every interval seconds to a file in the Prometheus text format, written beside it and
+// renamed over it so readers never see it half written.  Lanes are the walkers, replicas or branches running at once.
+class fgmetrics {
+public:
+    struct lane {
+        std::atomic<int> used, achieved, minmuls, twoplus, entries;
+        std::atomic<vlong> since;
+    };
+    static const int lanes = 64;
+    static const vlong gap = 1 << 18;
+
+    std::string fname, labels;
+    double interval;
+    int target;
+    vlong flimit;
+    std::atomic<vlong> flips, plus;
+    std::atomic<int> best;
+    lane at[lanes];
+    std::mutex lock;
+    std::condition_variable wake;
+    bool done;
+    std::thread thread;
+
+    // Constructor, starts the thread writing to name every secs seconds, labelled with the seed and run number.
+    fgmetrics(const std::string& name, double secs, vlong master, vlong run, int tgt, vlong limit, int rank) {
+        fname = name;
+        interval = secs;
+        labels = "{seed=\"" + std::to_string(master) + "\",run=\"" + std::to_string(run) + "\"";
+        target = tgt;
+        flimit = limit;
+        flips = 0;
+        plus = 0;
+        best = rank;
+        for (lane& x : at) {
+            x.used = 0;
+            x.achieved = x.minmuls = x.twoplus = x.entries = 0;
+            x.since = 0;
+        }
+        done = false;
+        thread = std::thread(&fgmetrics::loop, this);
+    }
+
+    // Destructor, writes the final metrics.
+    ~fgmetrics() {
+        {
+            std::lock_guard<std::mutex> hold(lock);
+            done = true;
+        }
+        wake.notify_all();
+        thread.join();
+    }
+
+    // Publish from a walk in lane k, counts since its last publication and its current gauges.
+    void add(int k, vlong f, vlong p, int achieved, int minmuls, int twoplus, int entries, vlong since) {
+        lane& x = at[k % lanes];
+        flips.fetch_add(f, std::memory_order_relaxed);
+        plus.fetch_add(p, std::memory_order_relaxed);
+        x.achieved.store(achieved, std::memory_order_relaxed);
+        x.minmuls.store(minmuls, std::memory_order_relaxed);
+        x.twoplus.store(twoplus, std::memory_order_relaxed);
+        x.entries.store(entries, std::memory_order_relaxed);
+        x.since.store(since, std::memory_order_relaxed);
+        x.used.store(1, std::memory_order_relaxed);
+        int b = best.load(std::memory_order_relaxed);
+        while (minmuls < b && !best.compare_exchange_weak(b, minmuls, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Write the metrics file, with the flip rate and seconds since the lowest rank last fell measured by the thread.
+    void write(double rate, double quiet, int finished) {
+        std::ostringstream out;
+        auto metric = [&](const char* name, const char* type, const char* help) {
+            out << "# HELP fg_" << name << " " << help << "\n# TYPE fg_" << name << " " << type << "\n";
+        };
+        metric("flips_total", "counter", "Flips made by the walks of the solve.");
+        out << "fg_flips_total" << labels << "} " << flips.load(std::memory_order_relaxed) << "\n";
+        metric("flips_per_second", "gauge", "Flip rate over the last interval.");
+        out << "fg_flips_per_second" << labels << "} " << (vlong)rate << "\n";
+        metric("plus_total", "counter", "Plus transitions made by the walks of the solve.");
+        out << "fg_plus_total" << labels << "} " << plus.load(std::memory_order_relaxed) << "\n";
+        metric("lowest_rank", "gauge", "Lowest rank reached by any walk of the solve.");
+        out << "fg_lowest_rank" << labels << "} " << best.load(std::memory_order_relaxed) << "\n";
+        metric("target_rank", "gauge", "Target rank of the solve.");
+        out << "fg_target_rank" << labels << "} " << target << "\n";
+        metric("flip_limit", "gauge", "Flip limit of each walk.");
+        out << "fg_flip_limit" << labels << "} " << flimit << "\n";
+        metric("seconds_since_reduction", "gauge", "Seconds since the lowest rank of the solve last fell.");
+        out << "fg_seconds_since_reduction" << labels << "} " << (vlong)quiet << "\n";
+        metric("finished", "gauge", "1 once the solve has ended.");
+        out << "fg_finished" << labels << "} " << finished << "\n";
+        const char* names[5][2] = {
+            { "rank", "Current rank of the walk." },
+            { "walk_lowest_rank", "Lowest rank reached by the walk." },
+            { "twoplus", "Components shared by two or more products, the flips available." },
+            { "dictionary_entries", "Entries in the 1048576 slot dictionary of distinct components." },
+            { "flips_since_reduction", "Flips since the walk last reached a new lowest rank." } };
+        for (int i = 0; i < 5; i++) {
+            metric(names[i][0], "gauge", names[i][1]);
+            for (int k = 0; k < lanes; k++) {
+                lane& x = at[k];
+                if (!x.used.load(std::memory_order_relaxed)) {
+                    continue;
                 }
+                vlong v = i == 0 ? x.achieved.load(std::memory_order_relaxed) : i == 1 ? x.minmuls.load(std::memory_order_relaxed) : i == 2 ? x.twoplus.load(std::memory_order_relaxed) : i == 3 ? x.entries.load(std::memory_order_relaxed) : x.since.load(std::memory_order_relaxed);
+                out << "fg_" << names[i][0] << labels << ",walk=\"" << k << "\"} " << v << "\n";
             }
-            else {
-                int b = avail.back();
-                avail.pop_back();
-                uniques.add(m, b);
-                unarray[b] = 1;
-                unarray[b + 1] = i;
+        }
+        metric("timestamp_seconds", "gauge", "Time the file was written.");
+        out << "fg_timestamp_seconds" << labels << "} " << (vlong)time(NULL) << "\n";
+        std::string tmp = fname + ".tmp";
+        std::ofstream f(tmp);
+        f << out.str();
+        f.close();
+#ifdef _WIN32
+        std::remove(fname.c_str());
+#endif
+        std::rename(tmp.c_str(), fname.c_str());
+    }
+
+    // Thread writing the metrics until the solve ends, at idle priority on Linux.
+    void loop() {
+#ifdef __linux__
+        struct sched_param sp;
+        sp.sched_priority = 0;
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &sp);
+#endif
+        auto last = std::chrono::steady_clock::now();
+        auto improved = last;
+        vlong before = 0;
+        int low = best.load();
+        std::unique_lock<std::mutex> hold(lock);
+        bool finished = false;
+        while (!finished) {
+            finished = wake.wait_for(hold, std::chrono::duration<double>(interval), [this]() { return done; });
+            auto now = std::chrono::steady_clock::now();
+            vlong f = flips.load(std::memory_order_relaxed);
+            int b = best.load(std::memory_order_relaxed);
+            if (b < low) {
+                low = b;
+                improved = now;
             }
-            achieved += 1;
+            double dt = std::chrono::duration<double>(now - last).count();
+            write(dt > 0 ? (f - before) / dt : 0, std::chrono::duration<double>(now - improved).count(), finished);
+            before = f;
+            last = now;
         }
     }
+};
 
-    std::vector<int> combs;
-    combs.reserve(100);
-    combs.push_back(0);
-    combs.push_back(0);
-    std::vector<int> ps;
-    ps.reserve(6400);
-    std::vector<int> qs;
-    qs.reserve(6400);
-    for (int x = 1; x < 80; x++) {
-        for (int y = 0; y < x; y++) {
-            ps.push_back(x);
-            qs.push_back(y);
-            ps.push_back(y);
-            qs.push_back(x);
+// Stop and snapshot requests, set by signal handlers or fgcancel and polled by walks every fgwalk::pollgap flips.
+// While stopping is set walks end with their best scheme so far, and each change of snapshots has a walk writing
+// a recovery file write it at once.
+std::atomic<int> fgstopping(0);
+std::atomic<int> fgsnapshots(0);
+
+// Handler for SIGTERM and SIGINT, requesting a stop, and SIGUSR1 where there is one, requesting a snapshot.
+extern "C" void fgonsignal(int sig) {
+#ifdef SIGUSR1
+    if (sig == SIGUSR1) {
+        fgsnapshots.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+#endif
+    fgstopping.store(1, std::memory_order_relaxed);
+}
+
+// Install the handlers for the solver program.
+void catchsignals() {
+    std::signal(SIGTERM, fgonsignal);
+    std::signal(SIGINT, fgonsignal);
+#ifdef SIGUSR1
+    std::signal(SIGUSR1, fgonsignal);
+#endif
+}
+
+// Flight recorder of a single walk, enough to replay it exactly with --replay and follow how it reached its ranks.
+// The log holds a magic number, the walk's input in the interface file format with its seed, then events.  Each
+// event is a varint of the flips since the one before times 8 plus its kind, then its fields as varints: a
+// checkpoint every gap flips with the rank and state hash, a plus transition with its slots p, q and r, a reduction
+// with the slot zeroed and the rank reached, a return to an earlier rank by backtracking or an undone lookahead
+// with the rank, and the end with the return code plus one and the lowest rank.  Flips follow from the seed and are
+// not logged.  When replaying, events are compared with those of the log instead of written, those past its end
+// being beyond a log cut short.
+class fgrecorder {
+public:
+    enum { checkpoint, plusevent, reduction, undo, end };
+    static const vlong gap = 1 << 20;
+    static const int fields[5];
+
+    std::ofstream file;
+    std::string out, expect;
+    vlong last;
+    size_t at;
+    bool replaying, diverged;
+
+    // Constructor.
+    fgrecorder() {
+        last = 0;
+        at = 0;
+        replaying = false;
+        diverged = false;
+    }
+
+    // Destructor, writes the events buffered.
+    ~fgrecorder() {
+        if (file.is_open()) {
+            flush();
         }
-        combs.push_back(ps.size());
     }
 
-    vlong plus = 0;
-    rcode = 0;
-    int exceed = 1 - maxsize;
-    vlong plusby;
-    if (achieved >= maxplus) {
-        plusby = flimit * 1007;
+    // Start a log in file fname for the walk with input text, returns false if it could not be opened.
+    bool open(const std::string& fname, const std::string& text) {
+        file.open(fname, std::ios::binary);
+        if (!file) {
+            return false;
+        }
+        out = "FGFLIGHT";
+        varint(text.size());
+        out += text;
+        flush();
+        return true;
+    }
+
+    // Replay against the events of a log.
+    void check(const std::string& events) {
+        expect = events;
+        replaying = true;
     }
-    else if (plimit < 0) {
-        plusby = flips + symm + mt() % (-2 * plimit);
+
+    inline void varint(vlong x) {
+        while (x >= 128) {
+            out += (char)((x & 127) | 128);
+            x >>= 7;
+        }
+        out += (char)x;
     }
-    else {
-        plusby = flips + plimit;
+
+    // Read a varint at i of s, returns false at the end of s.
+    static bool readvarint(const std::string& s, size_t& i, vlong& x) {
+        x = 0;
+        for (int b = 0; i < s.size() && b < 64; b += 7) {
+            unsigned char c = s[i++];
+            x |= (vlong)(c & 127) << b;
+            if (c < 128) {
+                return true;
+            }
+        }
+        return false;
     }
-    vlong recovery = 5000000000;
-    minmuls = achieved;
-    vlong limit = 0;
-    limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
 
-    if (symm == 3) {
-        while (true) {
-            flips += 3;
+    // Read the event at i of s, its flips counted on from flips, returns false at the end of s or a cut short event.
+    static bool readevent(const std::string& s, size_t& i, vlong& flips, int& kind, vlong* f) {
+        vlong x;
+        if (!readvarint(s, i, x) || (x & 7) > end) {
+            return false;
+        }
+        flips += x >> 3;
+        kind = x & 7;
+        for (int j = 0; j < fields[kind]; j++) {
+            if (!readvarint(s, i, f[j])) {
+                return false;
+            }
+        }
+        return true;
+    }
 
-            int p, q;
-            vlong mpe, mpf, mqe, mqf, mpen, mqfn;
-            if (maxsize == 0) {
-                while (true) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
-                    int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    if (permit[p][q]) {
-                        break;
-                    }
-                }
-                mpe = muls[me[p]];
-                mpf = muls[mf[p]];
-                mqe = muls[me[q]];
-                mqf = muls[mf[q]];
-                mpen = mqe ^ mpe;
-                mqfn = mqf ^ mpf;
-            }
-            else if (maxsize > 0) {
-                int k;
-                for (k = 0; k < 1000; k++) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
-                    int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpen = mqe ^ mpe;
-                    mqfn = mqf ^ mpf;
-                    int psize = bitcount(muls[p]) * bitcount(mpen) * bitcount(mpf);
-                    int qsize = bitcount(muls[q]) * bitcount(mqe) * bitcount(mqfn);
-                    if (permit[p][q] && psize <= maxsize && qsize <= maxsize) {
-                        break;
-                    }
+    void flush() {
+        file.write(out.data(), out.size());
+        out.clear();
+    }
+
+    // Log an event at flips with up to three fields.
+    void event(vlong flips, int kind, vlong a = 0, vlong b = 0, vlong c = 0) {
+        varint((flips - last) * 8 + kind);
+        last = flips;
+        vlong f[3] = { a, b, c };
+        for (int j = 0; j < fields[kind]; j++) {
+            varint(f[j]);
+        }
+        if (replaying) {
+            if (!diverged && at < expect.size() && (at + out.size() > expect.size() || expect.compare(at, out.size(), out) != 0)) {
+                diverged = true;
+            }
+            at += out.size();
+            out.clear();
+        }
+        else if (out.size() >= 65536 || kind == end) {
+            flush();
+        }
+    }
+};
+
+const int fgrecorder::fields[5] = { 2, 3, 2, 1, 2 };
+
+// Flip graph random walk, holding the multiplications and all bookkeeping for one solve.
+class fgwalk {
+public:
+    int nomuls, rcode, target, rseed, symm, achieved, maxplus, minmuls, maxsize, termination, split, exceed;
+    vlong flips, flimit, plimit, plus, plusby, recovery, limit;
+    std::string dumpfile;
+    std::vector<vlong> muls;
+    std::vector<vlong> best;
+    std::vector<int> me;
+    std::vector<int> mf;
+    std::mt19937 mt;
+    fgarena arena;
+    fgdict uniques;
+    int* unarray;
+    std::vector<int> avail;
+    fgdict twoplusd;
+    std::vector<vlong> twoplusl;
+    std::vector<std::vector<int>> permit;
+    std::vector<int> combs;
+    std::vector<int> ps;
+    std::vector<int> qs;
+
+    // Size tracking for MAXIMUM_SIZE constrained walks, per-slot set bits and per-key admissible flips.
+    // A key's list is valid while its length is unchanged and none of its products changed since it was built.
+    // Keys with admissible flips are kept in okkeys, topped up from the products changed since the last look
+    // and dropped when found empty, as only a key with a changed product can gain an admissible flip.
+    vlong tick;
+    std::vector<int> pop;
+    std::vector<vlong> pver;
+    std::vector<std::vector<int>> okpairs;
+    std::vector<vlong> okstamp;
+    std::vector<int> oklen;
+    std::vector<int> okkeys;
+    std::vector<int> okpos;
+    std::vector<int> pdirty;
+    std::vector<int> dirty;
+    bool okbuilt;
+
+    // Undo journal of multiplication writes, slot and previous value, for tentative plus transitions and backtracking.
+    // While jbest is set the best state is the current multiplications with the whole journal undone.
+    int lookahead, lookfrom, lookmark;
+    vlong backtrack, lookby, lookplus, bestflips;
+    bool journal, jbest;
+    std::vector<int> jslots;
+    std::vector<vlong> jvals;
+
+    // Greedy reduction seeking, candidate flips between slots that share both their component and the one at me[].
+    // Flipping such a pair zeroes a component, so it reduces at once, greedy is the percentage of steps that take one.
+    int greedy;
+    vlong reductions, greedyflips;
+    std::vector<int> gps;
+    std::vector<int> gqs;
+
+    // State hash, the sum over products of a hash of each product that is the same for all its rotations.
+    // It does not depend on where products sit in muls, and is kept up to date on every write while hashing is set.
+    // Tabu keeps the hashes of the last tabu states, a step that returns to one of them is undone.
+    // The window is counted in a small open addressing table rather than an fgdict, so it stays in cache.
+    vlong hash, besthash, tabuhits;
+    std::vector<vlong> phash;
+    bool hashing;
+    int tabu, tabupos, tabumask;
+    std::vector<vlong> taburing;
+    std::vector<vlong> tabukeys;
+    std::vector<int> tabucounts;
+
+    // Tensor fingerprint, the scheme summed over rotations and evaluated on 64 random triples of GF(2) vectors.
+    // Flips and plus transitions leave it unchanged, so any change means the walk has gone wrong.
+    // Sentinel 0 checks it at checkpoints, 1 keeps it up to date on every write and checks it after every step.
+    int sentinel;
+    vlong fingerprint, fprint;
+
+    // Elite pool and stop flag shared with other walkers, both NULL for a single walker.
+    fgpool* pool;
+    fgshared* shared;
+    std::atomic<int>* stop;
+    int published;
+
+    // Accepted exchanges of plus transition intervals with neighbouring replicas.
+    vlong swaps;
+
+    // Rank at or below which a branching walk stops to be cloned, and the number of clones made.
+    int branchat;
+    vlong branches;
+
+    // Predictive termination, rates[r] is the chance per flip of reducing from a new lowest rank r, from past runs.
+    // Every predictgap flips the walk stops if its chance of reaching target in the flips it has left is below
+    // predict times that of a fresh walk with the whole flip limit.  Reach holds the flips at each new lowest rank.
+    double predict, pfresh;
+    vlong predictby, predictgap;
+    std::vector<double> rates;
+    std::vector<vlong> reach;
+
+    // Live metrics, published every fgmetrics::gap flips to lane of metrics if set, flips and plus transitions
+    // counted from mflips and mplus.
+    fgmetrics* metrics;
+    int lane;
+    vlong metricsby, mflips, mplus;
+
+    // Flight recorder if set, the next checkpoint due at recordby flips.
+    fgrecorder* recorder;
+    vlong recordby;
+
+    // Stop requests, the wall clock deadline if timed and the snapshot requests seen, polled every pollgap flips.
+    static const vlong pollgap = 1 << 16;
+    vlong pollby;
+    bool timed;
+    std::chrono::steady_clock::time_point deadline;
+    int snapshots;
+    std::vector<vlong> pfprint;
+    std::vector<vlong> fptab;
+
+    // Constructor, sets up bookkeeping for the given multiplications.
+    fgwalk(std::vector<vlong>& m, vlong f, int t, vlong fl, vlong pl, int term, int rs, int sy, int mp, int sp, int ms, int gr, int hp)
+        : arena(2 * fgdict::arenabytes + m.size() * (m.size() + 1) * sizeof(int) + 64, hp), uniques(&arena), twoplusd(&arena) {
+        muls = m;
+        best = m;
+        nomuls = muls.size();
+        flips = f;
+        target = t;
+        flimit = fl;
+        plimit = pl;
+        termination = term;
+        rseed = rs;
+        symm = sy;
+        maxplus = mp;
+        split = sp;
+        maxsize = ms;
+        rcode = 0;
+        plus = 0;
+        lookahead = 0;
+        backtrack = 0;
+        lookby = 0;
+        bestflips = f;
+        journal = false;
+        jbest = false;
+        greedy = gr;
+        reductions = 0;
+        greedyflips = 0;
+        hashing = false;
+        tabu = 0;
+        tabupos = 0;
+        tabuhits = 0;
+        sentinel = 0;
+        pool = NULL;
+        shared = NULL;
+        stop = NULL;
+
+        me.assign(nomuls, 0);
+        mf.assign(nomuls, 0);
+        for (int i = 0; i < nomuls; i += 3) {
+            me[i] = i + 2;
+            mf[i] = i + 1;
+            me[i + 1] = i;
+            mf[i + 1] = i + 2;
+            me[i + 2] = i + 1;
+            mf[i + 2] = i;
+        }
+
+        mt.seed(rseed);
+
+        unarray = (int*)arena.take(nomuls * (nomuls + 1) * sizeof(int));
+        if (unarray == NULL) {
+            unarray = new int[nomuls * (nomuls + 1)];
+        }
+        for (int i = 0; i < nomuls; i++) {
+            int b = i * (nomuls + 1);
+            avail.push_back(b);
+        }
+
+        permit.reserve(nomuls);
+        for (int i = 0; i < nomuls; i++) {
+            std::vector<int> p;
+            p.reserve(nomuls);
+            for (int j = 0; j < nomuls; j++) {
+                if (i / symm == j / symm) {
+                    p.push_back(0);
                 }
-                if (k == 1000) {
-                    rcode = 6;
-                    break;
+                else {
+                    p.push_back(1);
                 }
             }
-            else {
-                int k;
-                for (k = 0; k < 1000; k++) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
+            permit.push_back(p);
+        }
+
+        achieved = 0;
+        for (int i = 0; i < nomuls; i++) {
+            vlong m = muls[i];
+            if (m > 0) {
+                if (uniques.contains(m)) {
+                    int b = uniques.getvalue(m);
                     int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpen = mqe ^ mpe;
-                    mqfn = mqf ^ mpf;
-                    if (permit[p][q] && bitlimit(mpen, exceed) && bitlimit(mqfn, exceed)) {
-                        break;
+                    l++;
+                    unarray[b + l] = i;
+                    unarray[b] = l;
+                    if (!twoplusd.contains(m)) {
+                        twoplusd.add(m, twoplusl.size());
+                        twoplusl.push_back(m);
                     }
                 }
-                if (k == 1000) {
-                    rcode = 6;
-                    break;
+                else {
+                    int b = avail.back();
+                    avail.pop_back();
+                    uniques.add(m, b);
+                    unarray[b] = 1;
+                    unarray[b + 1] = i;
                 }
+                achieved += 1;
             }
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-            muls[me[p]] = mpen;
-
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-            muls[mf[q]] = mqfn;
-
-            if (mpen == 0) {
-                vlong mpd = muls[p];
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, p, mpd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[p], mpf);
-                muls[p] = 0;
-                muls[mf[p]] = 0;
-                achieved -= 3;
-                if (achieved < minmuls) {
-                    minmuls = achieved;
-                    if (achieved > target) {
-                        limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
-                    }
+        }
+
+        combs.reserve(100);
+        combs.push_back(0);
+        combs.push_back(0);
+        ps.reserve(6400);
+        qs.reserve(6400);
+        for (int x = 1; x < 80; x++) {
+            for (int y = 0; y < x; y++) {
+                ps.push_back(x);
+                qs.push_back(y);
+                ps.push_back(y);
+                qs.push_back(x);
+            }
+            combs.push_back(ps.size());
+        }
+
+        if (greedy > 0) {
+            collideall();
+        }
+
+        phash.assign(nomuls / 3, 0);
+        fullhash();
+        besthash = hash;
+
+        std::mt19937_64 fmt(0x5DEECE66DULL);
+        fptab.assign(3 * 8 * 256, 0);
+        for (int t = 0; t < 3; t++) {
+            for (int j = 0; j < 8; j++) {
+                vlong cols[8];
+                for (int i = 0; i < 8; i++) {
+                    cols[i] = fmt();
                 }
-                if (achieved <= minmuls) {
-                    for (int l = 0; l < nomuls; l++) {
-                        best[l] = muls[l];
+                for (int b = 0; b < 256; b++) {
+                    vlong r = 0;
+                    for (int i = 0; i < 8; i++) {
+                        if (b & (1 << i)) {
+                            r ^= cols[i];
+                        }
                     }
-                }
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
-                }
-                else {
-                    plusby = flips + plimit;
-                }
-                if (twoplusl.size() == 0) {
-                    rcode = -1;
-                    break;
-                }
-                if (achieved <= target) {
-                    break;
-                }
-                bool trigger = true;
-                for (int j = 0; j < twoplusl.size(); j++) {
-                    vlong v = twoplusl[j];
-                    int b = uniques.getvalue(v);
-                    int t = unarray[b + 1] / 3;
-                    for (int i = 1; i < unarray[b]; i++) {
-                        int u = unarray[b + i + 1] / 3;
-                        if (t != u) {
-                            trigger = false;
-                        }
-                    }
-                }
-                if (trigger) {
-                    plusby = flips;
+                    fptab[t * 2048 + j * 256 + b] = r;
                 }
             }
+        }
+        pfprint.assign(nomuls / 3, 0);
+        fprint = 0;
+        for (int g = 0; g < nomuls / 3; g++) {
+            pfprint[g] = prodprint(muls, 3 * g);
+            fprint ^= pfprint[g];
+        }
+        fingerprint = fprint;
 
-            if (mqfn == 0) {
-                vlong mqd = muls[q];
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[q], mqe);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-                muls[q] = 0;
-                muls[me[q]] = 0;
-                achieved -= 3;
-                if (achieved < minmuls) {
-                    minmuls = achieved;
-                    if (achieved > target) {
-                        limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
-                    }
-                }
-                if (achieved <= minmuls) {
-                    for (int l = 0; l < nomuls; l++) {
-                        best[l] = muls[l];
-                    }
-                }
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
-                }
-                else {
-                    plusby = flips + plimit;
-                }
-                if (twoplusl.size() == 0) {
-                    rcode = -1;
-                    break;
-                }
-                if (achieved <= target) {
-                    break;
-                }
-                bool trigger = true;
-                for (int j = 0; j < twoplusl.size(); j++) {
-                    vlong v = twoplusl[j];
-                    int b = uniques.getvalue(v);
-                    int t = unarray[b + 1] / 3;
-                    for (int i = 1; i < unarray[b]; i++) {
-                        int u = unarray[b + i + 1] / 3;
-                        if (t != u) {
-                            trigger = false;
-                        }
-                    }
-                }
-                if (trigger) {
-                    plusby = flips;
-                }
+        exceed = 1 - maxsize;
+        if (maxsize != 0) {
+            tick = 1;
+            pop.assign(nomuls, 0);
+            for (int i = 0; i < nomuls; i++) {
+                pop[i] = bitcount(muls[i]);
             }
+            pver.assign(nomuls / 3, 1);
+            okpairs.resize(nomuls);
+            okstamp.assign(nomuls, 0);
+            oklen.assign(nomuls, 0);
+            okpos.assign(nomuls, -1);
+            pdirty.assign(nomuls / 3, 0);
+        }
+        okbuilt = false;
 
-            if (flips >= plusby) {
-                if (flips >= recovery) {
-                    recovery += 5000000000;
-                    std::ofstream output_file(argv[1]);
-                    output_file << nomuls << " " << flips << " " << 2 << " " << target << " " << flimit << " ";
-                    output_file << plimit << " " << termination << " " << rseed << " " << symm << " " << maxplus << " ";
-                    output_file << achieved << " " << minmuls << " " << plus << "\n";
-                    for (vlong m : muls) {
-                        output_file << m << "\n";
-                    }
-                }
-                int r;
-                for (r = 0; r < nomuls; r++) {
-                    if (muls[r] == 0) break;
-                }
-                int p, q;
-                vlong mpd, mpe, mpf, mqd, mqe, mqf;
-                vlong mpdn, mpen, mpfn, mqdn, mqen, mqfn, mrdn, mren, mrfn;
-                while (true) {
-                    p = mt() % nomuls;
-                    q = mt() % nomuls;
-                    mpd = muls[p];
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqd = muls[q];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpdn = mpd;
-                    mpen = mpe ^ mqe;
-                    mpfn = mpf;
-                    mqdn = mpd;
-                    mqen = mqe;
-                    mqfn = mpf ^ mqf;
-                    mrdn = mpd ^ mqd;
-                    mren = mqe;
-                    mrfn = mqf;
-                    bool ok = true;
-                    if (maxsize > 0) {
-                        int psize = bitcount(mpdn) * bitcount(mpen) * bitcount(mpfn);
-                        int qsize = bitcount(mqdn) * bitcount(mqen) * bitcount(mqfn);
-                        int rsize = bitcount(mrdn) * bitcount(mren) * bitcount(mrfn);
-                        if (psize > maxsize || qsize > maxsize || rsize > maxsize) {
-                            ok = false;
-                        }
-                    }
-                    else if (maxsize < 0) {
-                        if (!(bitlimit(mpen, exceed) && bitlimit(mqfn, exceed) && bitlimit(mrdn, exceed))) {
-                            ok = false;
-                        }
-                    }
-                    if (mpd == 0 || mqd == 0) ok = false;
-                    if (mpd == mqd || mpe == mqe || mpf == mqf) ok = false;
-                    if (!permit[p][q]) ok = false;
-                    if (ok) break;
-                }
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mpd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, r, mrdn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[r], mqe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[r], mqf);
-                muls[p] = mpdn;
-                muls[me[p]] = mpen;
-                muls[mf[p]] = mpfn;
-                muls[q] = mqdn;
-                muls[me[q]] = mqen;
-                muls[mf[q]] = mqfn;
-                muls[r] = mrdn;
-                muls[me[r]] = mren;
-                muls[mf[r]] = mrfn;
-                plus += 3;
-                achieved += 3;
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
-                }
-                else {
-                    plusby = flips + plimit;
-                }
-            }
+        if (achieved >= maxplus) {
+            plusby = flimit * 1007;
+        }
+        else if ((long long)plimit < 0) {
+            plusby = flips + symm + mt() % (-2 * (long long)plimit);
+        }
+        else {
+            plusby = flips + plimit;
+        }
+        recovery = 5000000000;
+        minmuls = achieved;
+        published = achieved;
+        swaps = 0;
+        branchat = -1;
+        branches = 0;
+        predict = 0;
+        pfresh = 0;
+        predictby = 0;
+        predictgap = 0;
+        metrics = NULL;
+        lane = 0;
+        metricsby = ~0ULL;
+        pollby = f + pollgap;
+        timed = false;
+        recorder = NULL;
+        recordby = ~0ULL;
+        snapshots = fgsnapshots.load();
+        reach.push_back(f);
+        limit = 0;
+        limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
+    }
 
-            if (flips >= limit) {
-                if (flips >= flimit) {
-                    rcode = 1;
-                }
-                else {
-                    rcode = 2;
-                }
-                break;
+    // Destructor.
+    ~fgwalk() {
+        if (arena.base == NULL) {
+            delete[] unarray;
+        }
+    }
+
+    // Set a multiplication component, bookkeeping for uniques must already be done.
+    inline void setmul(int s, vlong v) {
+        if (journal) {
+            jslots.push_back(s);
+            jvals.push_back(muls[s]);
+        }
+        putmul(s, v);
+    }
+
+    // Set a multiplication component without journalling, keeping size caches and state hash in step.
+    inline void putmul(int s, vlong v) {
+        int g = s / 3;
+        if (maxsize != 0) {
+            pop[s] = bitcount(v);
+            tick++;
+            pver[g] = tick;
+            if (!pdirty[g]) {
+                pdirty[g] = 1;
+                dirty.push_back(g);
             }
         }
+        muls[s] = v;
+        if (hashing) {
+            hash -= phash[g];
+            phash[g] = prodhash(3 * g);
+            hash += phash[g];
+        }
+        if (sentinel > 0) {
+            fprint ^= pfprint[g];
+            pfprint[g] = prodprint(muls, 3 * g);
+            fprint ^= pfprint[g];
+        }
     }
 
-    if (symm == 6) {
-        while (true) {
-            flips += 6;
+    // Inner products of component x with the 64 random vectors of table t, one per bit.
+    inline vlong fpmap(int t, vlong x) {
+        vlong r = 0;
+        for (int j = t * 2048; x != 0; j += 256) {
+            r ^= fptab[j + (x & 255)];
+            x >>= 8;
+        }
+        return r;
+    }
+
+    // Fingerprint of the product at slots i to i + 2 of m, summed over its three rotations.
+    inline vlong prodprint(const std::vector<vlong>& m, int i) {
+        vlong x = m[i];
+        vlong y = m[i + 1];
+        vlong z = m[i + 2];
+        if ((x | y | z) == 0) {
+            return 0;
+        }
+        vlong xa = fpmap(0, x), xb = fpmap(1, x), xc = fpmap(2, x);
+        vlong ya = fpmap(0, y), yb = fpmap(1, y), yc = fpmap(2, y);
+        vlong za = fpmap(0, z), zb = fpmap(1, z), zc = fpmap(2, z);
+        return (xa & yb & zc) ^ (ya & zb & xc) ^ (za & xb & yc);
+    }
+
+    // Fingerprint of a whole scheme.
+    vlong schemeprint(const std::vector<vlong>& m) {
+        vlong r = 0;
+        for (int i = 0; i < nomuls; i += 3) {
+            r ^= prodprint(m, i);
+        }
+        return r;
+    }
+
+    // Checkpoint for the tensor fingerprint, returns zero and sets rcode 5 if it has changed.
+    int checkprint() {
+        if (schemeprint(muls) != fingerprint) {
+            rcode = 5;
+            return 0;
+        }
+        return 1;
+    }
+
+    // Recalculate the state hash from scratch.
+    void fullhash() {
+        hash = 0;
+        for (int g = 0; g < nomuls / 3; g++) {
+            phash[g] = prodhash(3 * g);
+            hash += phash[g];
+        }
+    }
+
+    // Hash of the product at slots i to i + 2, taken from the least of its rotations compared as (x, y, z) tuples.
+    inline vlong prodhash(int i) {
+        vlong x = muls[i];
+        vlong y = muls[i + 1];
+        vlong z = muls[i + 2];
+        if ((x | y | z) == 0) {
+            return 0;
+        }
+        std::tuple<vlong, vlong, vlong> t = std::min(std::min(std::make_tuple(x, y, z), std::make_tuple(y, z, x)), std::make_tuple(z, x, y));
+        x = std::get<0>(t);
+        y = std::get<1>(t);
+        z = std::get<2>(t);
+        return mixhash((x * 0x9E3779B97F4A7C15ULL) ^ (y * 0xC2B2AE3D27D4EB4FULL + z * 0x165667B19E3779F9ULL));
+    }
+
+    // Position of a state hash in the tabu table, or of the empty entry where it would go.
+    inline int tabufind(vlong h) {
+        int i = h & tabumask;
+        while (tabukeys[i] != 0 && tabukeys[i] != h) {
+            i = (i + 1) & tabumask;
+        }
+        return i;
+    }
 
-            int p, q;
-            vlong mpd, mpe, mpf, mqd, mqe, mqf, mpen, mqfn;
-            if (maxsize == 0) {
+    // Returns non-zero if a state hash is in the tabu window.
+    inline int tabuseen(vlong h) {
+        h |= (h == 0);
+        return tabukeys[tabufind(h)] != 0;
+    }
+
+    // Add a state hash to the tabu window, dropping the oldest once it is full.
+    void tabupush(vlong h) {
+        h |= (h == 0);
+        if (taburing.size() < (size_t)tabu) {
+            taburing.push_back(h);
+        }
+        else {
+            int i = tabufind(taburing[tabupos]);
+            tabucounts[i]--;
+            if (tabucounts[i] == 0) {
+                int j = i;
                 while (true) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
-                    int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    if (permit[p][q]) {
-                        break;
-                    }
-                }
-                mpd = muls[p];
-                mpe = muls[me[p]];
-                mpf = muls[mf[p]];
-                mqd = muls[q];
-                mqe = muls[me[q]];
-                mqf = muls[mf[q]];
-                mpen = mqe ^ mpe;
-                mqfn = mqf ^ mpf;
-            }
-            else if (maxsize > 0) {
-                int k;
-                for (k = 0; k < 1000; k++) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
-                    int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    mpd = muls[p];
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqd = muls[q];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpen = mqe ^ mpe;
-                    mqfn = mqf ^ mpf;
-                    int psize = bitcount(mpd) * bitcount(mpen) * bitcount(mpf);
-                    int qsize = bitcount(mqd) * bitcount(mqe) * bitcount(mqfn);
-                    if (permit[p][q] && psize <= maxsize && qsize <= maxsize) {
+                    j = (j + 1) & tabumask;
+                    if (tabukeys[j] == 0) {
                         break;
                     }
-                }
-                if (k == 1000) {
-                    rcode = 6;
-                    break;
-                }
-            }
-            else {
-                int k;
-                for (k = 0; k < 1000; k++) {
-                    unsigned int sample = mt();
-                    vlong v = twoplusl[sample % twoplusl.size()];
-                    int b = uniques.getvalue(v);
-                    int l = unarray[b];
-                    b++;
-                    if (l == 2) {
-                        if (sample & 65536) {
-                            p = unarray[b];
-                            q = unarray[b + 1];
-                        }
-                        else {
-                            p = unarray[b + 1];
-                            q = unarray[b];
-                        }
-                    }
-                    else {
-                        int x = (sample >> 16) % combs[l];
-                        p = unarray[b + ps[x]];
-                        q = unarray[b + qs[x]];
-                    }
-                    mpd = muls[p];
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqd = muls[q];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpen = mqe ^ mpe;
-                    mqfn = mqf ^ mpf;
-                    if (permit[p][q] && bitlimit(mpen, exceed) && bitlimit(mqfn, exceed)) {
-                        break;
+                    int k = tabukeys[j] & tabumask;
+                    if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j)) {
+                        tabukeys[i] = tabukeys[j];
+                        tabucounts[i] = tabucounts[j];
+                        i = j;
                     }
                 }
-                if (k == 1000) {
-                    rcode = 6;
-                    break;
-                }
+                tabukeys[i] = 0;
             }
+            taburing[tabupos] = h;
+            tabupos = (tabupos + 1) % tabu;
+        }
+        int i = tabufind(h);
+        if (tabukeys[i] == 0) {
+            tabukeys[i] = h;
+            tabucounts[i] = 0;
+        }
+        tabucounts[i]++;
+    }
 
-            int x = p % 6;
-            int pp;
-            if (x < 3) {
-                pp = p + 3;
+    // Undo journal entries back to mark, keeping the bookkeeping for uniques in step.
+    void rollback(int mark) {
+        for (int i = jslots.size() - 1; i >= mark; i--) {
+            int s = jslots[i];
+            vlong v = jvals[i];
+            if (muls[s] != 0) {
+                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, s, muls[s]);
             }
-            else {
-                pp = p - 3;
+            if (v != 0) {
+                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, s, v);
             }
-            x = q % 6;
-            int qq;
-            if (x < 3) {
-                qq = q + 3;
+            putmul(s, v);
+        }
+        jslots.resize(mark);
+        jvals.resize(mark);
+    }
+
+    // Record the current multiplications as best, by clearing the journal where possible.
+    void savebest() {
+        bestflips = flips;
+        if (!hashing) {
+            fullhash();
+        }
+        besthash = hash;
+        if (backtrack > 0 && lookby == 0) {
+            jslots.clear();
+            jvals.clear();
+            jbest = true;
+        }
+        else {
+            for (int l = 0; l < nomuls; l++) {
+                best[l] = muls[l];
             }
-            else {
-                qq = q - 3;
+            jbest = false;
+        }
+    }
+
+    // Copy best state out of the journal, returns the best multiplications.
+    std::vector<vlong>& getbest() {
+        if (jbest) {
+            best = muls;
+            for (int i = jslots.size() - 1; i >= 0; i--) {
+                best[jslots[i]] = jvals[i];
             }
+            jbest = false;
+        }
+        return best;
+    }
 
-            vlong mppd = muls[pp];
-            vlong mppe = muls[me[pp]];
-            vlong mppf = muls[mf[pp]];
-            vlong mqqd = muls[qq];
-            vlong mqqe = muls[me[qq]];
-            vlong mqqf = muls[mf[qq]];
-            vlong mppen = mqqe ^ mppe;
-            vlong mqqfn = mqqf ^ mppf;
-
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-            muls[me[p]] = mpen;
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppe);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
-            muls[me[pp]] = mppen;
-
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-            muls[mf[q]] = mqfn;
-            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqf);
-            flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
-            muls[mf[qq]] = mqqfn;
-
-            if (mpen == 0 || (mpd == mppd && mpen == mppen && mpf == mppf)) {
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, p, mpd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[p], mpf);
-                muls[p] = 0;
-                muls[mf[p]] = 0;
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, pp, mppd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[pp], mppf);
-                muls[pp] = 0;
-                muls[mf[pp]] = 0;
-                if (mpen != 0) {
-                    muls[me[p]] = 0;
-                    muls[me[pp]] = 0;
-                }
-                achieved -= 6;
-                if (achieved < minmuls) {
-                    minmuls = achieved;
-                    if (achieved > target) {
-                        limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
-                    }
-                }
-                if (achieved <= minmuls) {
-                    for (int l = 0; l < nomuls; l++) {
-                        best[l] = muls[l];
-                    }
-                }
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
-                }
-                else {
-                    plusby = flips + plimit;
-                }
-                if (twoplusl.size() == 0) {
-                    rcode = -1;
-                    break;
-                }
-                if (achieved <= target) {
-                    break;
-                }
-                bool trigger = true;
-                for (int j = 0; j < twoplusl.size(); j++) {
-                    vlong v = twoplusl[j];
-                    int b = uniques.getvalue(v);
-                    int t = unarray[b + 1] / 6;
-                    for (int i = 1; i < unarray[b]; i++) {
-                        int u = unarray[b + i + 1] / 6;
-                        if (t != u) {
-                            trigger = false;
-                        }
-                    }
-                }
-                if (trigger) {
-                    plusby = flips;
-                }
-            }
-
-            if (mqfn == 0 || (mqd == mqqd && mqe == mqqe && mqfn == mqqfn)) {
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[q], mqe);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-                muls[q] = 0;
-                muls[me[q]] = 0;
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mqqd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[qq], mqqe);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
-                muls[qq] = 0;
-                muls[me[qq]] = 0;
-                if (mqfn != 0) {
-                    muls[mf[q]] = 0;
-                    muls[mf[qq]] = 0;
-                }
-                achieved -= 6;
-                if (achieved < minmuls) {
-                    minmuls = achieved;
-                    if (achieved > target) {
-                        limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
-                    }
-                }
-                if (achieved <= minmuls) {
-                    for (int l = 0; l < nomuls; l++) {
-                        best[l] = muls[l];
-                    }
-                }
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
-                }
-                else {
-                    plusby = flips + plimit;
-                }
-                if (twoplusl.size() == 0) {
-                    rcode = -1;
-                    break;
-                }
-                if (achieved <= target) {
-                    break;
+    // Keep journal bounded outside a lookahead, the best state is copied out once it grows too long.
+    inline void trimjournal() {
+        if (jslots.size() > 16 * (size_t)nomuls) {
+            getbest();
+            jslots.clear();
+            jvals.clear();
+        }
+    }
+
+    // Return to the best state, from the journal if it still holds it.
+    void tobest() {
+        if (!jbest) {
+            jslots.clear();
+            jvals.clear();
+            for (int l = 0; l < nomuls; l++) {
+                if (muls[l] != best[l]) {
+                    jslots.push_back(l);
+                    jvals.push_back(best[l]);
                 }
-                bool trigger = true;
-                for (int j = 0; j < twoplusl.size(); j++) {
-                    vlong v = twoplusl[j];
-                    int b = uniques.getvalue(v);
-                    int t = unarray[b + 1] / 6;
-                    for (int i = 1; i < unarray[b]; i++) {
-                        int u = unarray[b + i + 1] / 6;
-                        if (t != u) {
-                            trigger = false;
-                        }
+            }
+        }
+        rollback(0);
+        if (greedy > 0) {
+            collideall();
+        }
+        jbest = true;
+        achieved = minmuls;
+        bestflips = flips;
+        setplusby();
+        if (recorder != NULL) {
+            recorder->event(flips, fgrecorder::undo, achieved);
+        }
+    }
+
+    // Start a tentative plus transition, kept only if the walk drops below the current rank within lookahead flips.
+    inline void startlook() {
+        if (!journal) {
+            journal = true;
+            jslots.clear();
+            jvals.clear();
+        }
+        lookmark = jslots.size();
+        lookfrom = achieved;
+        lookplus = plus;
+        lookby = flips + lookahead;
+    }
+
+    // End a tentative plus transition, undoing it unless the rank dropped.
+    inline void endlook(bool keep) {
+        if (!keep) {
+            rollback(lookmark);
+            if (greedy > 0) {
+                collideall();
+            }
+            achieved = lookfrom;
+            plus = lookplus;
+            setplusby();
+            if (recorder != NULL) {
+                recorder->event(flips, fgrecorder::undo, achieved);
+            }
+        }
+        lookby = 0;
+        if (backtrack == 0 && tabu == 0) {
+            journal = false;
+            jslots.clear();
+            jvals.clear();
+        }
+    }
+
+    // Record candidate flips that reduce at once for the pairs of components including slot c.
+    inline void collide(int c) {
+        int s = c;
+        for (int k = 0; k < 2; k++) {
+            vlong x = muls[s];
+            if (x != 0 && gps.size() < (size_t)nomuls) {
+                vlong y = muls[me[s]];
+                int b = uniques.getvalue(x);
+                int l = unarray[b];
+                for (int i = 1; i <= l; i++) {
+                    int t = unarray[b + i];
+                    if (t != s && muls[me[t]] == y && permit[s][t]) {
+                        gps.push_back(s);
+                        gqs.push_back(t);
                     }
                 }
-                if (trigger) {
-                    plusby = flips;
-                }
             }
+            s = mf[c];
+        }
+    }
 
-            if (flips >= plusby) {
-                if (flips >= recovery) {
-                    recovery += 5000000000;
-                    std::ofstream output_file(argv[1]);
-                    output_file << nomuls << " " << flips << " " << 2 << " " << target << " " << flimit << " ";
-                    output_file << plimit << " " << termination << " " << rseed << " " << symm << " " << maxplus << " ";
-                    output_file << achieved << " " << minmuls << " " << plus << "\n";
-                    for (vlong m : muls) {
-                        output_file << m << "\n";
+    // Rebuild candidate flips that reduce at once from scratch.
+    void collideall() {
+        gps.clear();
+        gqs.clear();
+        for (int i = 0; i < nomuls; i++) {
+            vlong x = muls[i];
+            if (x != 0 && gps.size() < (size_t)nomuls) {
+                vlong y = muls[me[i]];
+                int b = uniques.getvalue(x);
+                for (int j = 1; j <= unarray[b]; j++) {
+                    int t = unarray[b + j];
+                    if (t > i && muls[me[t]] == y && permit[i][t]) {
+                        gps.push_back(i);
+                        gqs.push_back(t);
                     }
                 }
-                int r;
-                for (r = 0; r < nomuls; r++) {
-                    if (muls[r] == 0) break;
+            }
+        }
+    }
+
+    // Take the most recent candidate flip that still reduces, returns zero if none is left.
+    inline int greedysample(int& p, int& q) {
+        while (gps.size() > 0) {
+            p = gps.back();
+            q = gqs.back();
+            gps.pop_back();
+            gqs.pop_back();
+            if (muls[p] != 0 && muls[p] == muls[q] && muls[me[p]] == muls[me[q]] && (maxsize == 0 || sizeok(p, q))) {
+                return 1;
+            }
+        }
+        return 0;
+    }
+
+    // Returns non-zero if flipping p with q keeps both new multiplications within the size limit.
+    inline int sizeok(int p, int q) {
+        if (!permit[p][q]) {
+            return 0;
+        }
+        vlong mpen = muls[me[q]] ^ muls[me[p]];
+        vlong mqfn = muls[mf[q]] ^ muls[mf[p]];
+        if (maxsize > 0) {
+            int psize = pop[p] * bitcount(mpen) * pop[mf[p]];
+            int qsize = pop[q] * pop[me[q]] * bitcount(mqfn);
+            return psize <= maxsize && qsize <= maxsize;
+        }
+        return bitlimit(mpen, exceed) && bitlimit(mqfn, exceed);
+    }
+
+    // Returns list of admissible flips for key at b in unarray, rebuilt only if out of date.
+    inline std::vector<int>& sizelist(int b) {
+        int g = b / (nomuls + 1);
+        int l = unarray[b];
+        std::vector<int>& ok = okpairs[g];
+        bool valid = oklen[g] == l;
+        for (int i = 1; valid && i <= l; i++) {
+            if (pver[unarray[b + i] / 3] > okstamp[g]) {
+                valid = false;
+            }
+        }
+        if (!valid) {
+            ok.clear();
+            for (int x = 0; x < combs[l]; x++) {
+                if (sizeok(unarray[b + 1 + ps[x]], unarray[b + 1 + qs[x]])) {
+                    ok.push_back(x);
                 }
-                int rr = r + 3;
-                int p, q, pp, qq;
-                vlong mpd, mpe, mpf, mqd, mqe, mqf;
-                vlong mpdn, mpen, mpfn, mqdn, mqen, mqfn, mrdn, mren, mrfn;
-                vlong mppd, mppe, mppf, mqqd, mqqe, mqqf;
-                vlong mppdn, mppen, mppfn, mqqdn, mqqen, mqqfn, mrrdn, mrren, mrrfn;
-                while (true) {
-                    p = mt() % nomuls;
-                    q = mt() % nomuls;
-                    int x = p % 6;
-                    if (x < 3) {
-                        pp = p + 3;
-                    }
-                    else {
-                        pp = p - 3;
-                    }
-                    x = q % 6;
-                    if (x < 3) {
-                        qq = q + 3;
-                    }
-                    else {
-                        qq = q - 3;
-                    }
-                    mpd = muls[p];
-                    mpe = muls[me[p]];
-                    mpf = muls[mf[p]];
-                    mqd = muls[q];
-                    mqe = muls[me[q]];
-                    mqf = muls[mf[q]];
-                    mpdn = mpd;
-                    mpen = mpe ^ mqe;
-                    mpfn = mpf;
-                    mqdn = mpd;
-                    mqen = mqe;
-                    mqfn = mpf ^ mqf;
-                    mrdn = mpd ^ mqd;
-                    mren = mqe;
-                    mrfn = mqf;
-                    mppd = muls[pp];
-                    mppe = muls[me[pp]];
-                    mppf = muls[mf[pp]];
-                    mqqd = muls[qq];
-                    mqqe = muls[me[qq]];
-                    mqqf = muls[mf[qq]];
-                    mppdn = mppd;
-                    mppen = mppe ^ mqqe;
-                    mppfn = mppf;
-                    mqqdn = mppd;
-                    mqqen = mqqe;
-                    mqqfn = mppf ^ mqqf;
-                    mrrdn = mppd ^ mqqd;
-                    mrren = mqqe;
-                    mrrfn = mqqf;
-                    bool ok = true;
-                    if (maxsize > 0) {
-                        int psize = bitcount(mpdn) * bitcount(mpen) * bitcount(mpfn);
-                        int qsize = bitcount(mqdn) * bitcount(mqen) * bitcount(mqfn);
-                        int rsize = bitcount(mrdn) * bitcount(mren) * bitcount(mrfn);
-                        if (psize > maxsize || qsize > maxsize || rsize > maxsize) {
-                            ok = false;
-                        }
-                    }
-                    else if (maxsize < 0) {
-                        if (!(bitlimit(mpen, exceed) && bitlimit(mqfn, exceed) && bitlimit(mrdn, exceed))) {
-                            ok = false;
+            }
+            okstamp[g] = tick;
+            oklen[g] = l;
+        }
+        return ok;
+    }
+
+    // Add key at b to okkeys if it has admissible flips and is not already there.
+    inline void okadd(int b) {
+        int g = b / (nomuls + 1);
+        if (okpos[g] < 0 && sizelist(b).size() > 0) {
+            okpos[g] = okkeys.size();
+            okkeys.push_back(b);
+        }
+    }
+
+    // Bring okkeys up to date, all keys the first time and afterwards the keys of the products changed since.
+    void okrefresh() {
+        if (!okbuilt) {
+            for (size_t j = 0; j < twoplusl.size(); j++) {
+                okadd(uniques.getvalue(twoplusl[j]));
+            }
+            okbuilt = true;
+        }
+        else {
+            for (int g : dirty) {
+                for (int s = 3 * g; s < 3 * g + 3; s++) {
+                    if (muls[s] != 0) {
+                        int b = uniques.getvalue(muls[s]);
+                        if (unarray[b] >= 2) {
+                            okadd(b);
                         }
                     }
-                    if (mpd == 0 || mqd == 0) ok = false;
-                    if (mppd == 0 || mqqd == 0) ok = false;
-                    if (mpd == mqd || mpe == mqe || mpf == mqf) ok = false;
-                    if (mppd == mqqd || mppe == mqqe || mppf == mqqf) ok = false;
-                    if (!permit[p][q]) ok = false;
-                    if (ok) break;
-                }
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mpd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, r, mrdn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[r], mqe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[r], mqf);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mqqd);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mppd);
-                flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqf);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, rr, mrrdn);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[rr], mqqe);
-                flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[rr], mqqf);
-                muls[p] = mpdn;
-                muls[me[p]] = mpen;
-                muls[mf[p]] = mpfn;
-                muls[q] = mqdn;
-                muls[me[q]] = mqen;
-                muls[mf[q]] = mqfn;
-                muls[r] = mrdn;
-                muls[me[r]] = mren;
-                muls[mf[r]] = mrfn;
-                muls[pp] = mppdn;
-                muls[me[pp]] = mppen;
-                muls[mf[pp]] = mppfn;
-                muls[qq] = mqqdn;
-                muls[me[qq]] = mqqen;
-                muls[mf[qq]] = mqqfn;
-                muls[rr] = mrrdn;
-                muls[me[rr]] = mrren;
-                muls[mf[rr]] = mrrfn;
-                plus += 6;
-                achieved += 6;
-                if (achieved >= maxplus) {
-                    plusby = flimit * 1007;
-                }
-                else if (plimit < 0) {
-                    plusby = flips + symm + mt() % (-2 * plimit);
                 }
-                else {
-                    plusby = flips + plimit;
+            }
+        }
+        for (int g : dirty) {
+            pdirty[g] = 0;
+        }
+        dirty.clear();
+    }
+
+    // Sample an admissible flip for constrained walks, returns zero only if none exists.
+    // Random pairs are tried first as they always were, okkeys is only needed when those are not admissible.
+    int sizesample(int& p, int& q) {
+        for (int k = 0; k < 1000; k++) {
+            unsigned int sample = mt();
+            vlong v = twoplusl[sample % twoplusl.size()];
+            int b = uniques.getvalue(v);
+            int x = (sample >> 16) % combs[unarray[b]];
+            p = unarray[b + 1 + ps[x]];
+            q = unarray[b + 1 + qs[x]];
+            if (sizeok(p, q)) {
+                return 1;
+            }
+        }
+        okrefresh();
+        while (okkeys.size() > 0) {
+            unsigned int sample = mt();
+            int i = sample % okkeys.size();
+            int b = okkeys[i];
+            if (unarray[b] >= 2) {
+                std::vector<int>& ok = sizelist(b);
+                if (ok.size() > 0) {
+                    int x = ok[(sample >> 16) % ok.size()];
+                    p = unarray[b + 1 + ps[x]];
+                    q = unarray[b + 1 + qs[x]];
+                    return 1;
                 }
             }
+            okpos[b / (nomuls + 1)] = -1;
+            okkeys[i] = okkeys.back();
+            okkeys.pop_back();
+            if (i < (int)okkeys.size()) {
+                okpos[okkeys[i] / (nomuls + 1)] = i;
+            }
+        }
+        return 0;
+    }
 
-            if (flips >= limit) {
-                if (flips >= flimit) {
-                    rcode = 1;
+    // Sample a flip for unconstrained walks.
+    inline void sample(int& p, int& q) {
+        while (true) {
+            unsigned int sample = mt();
+            vlong v = twoplusl[sample % twoplusl.size()];
+            int b = uniques.getvalue(v);
+            int l = unarray[b];
+            b++;
+            if (l == 2) {
+                if (sample & 65536) {
+                    p = unarray[b];
+                    q = unarray[b + 1];
                 }
                 else {
-                    rcode = 2;
+                    p = unarray[b + 1];
+                    q = unarray[b];
                 }
+            }
+            else {
+                int x = (sample >> 16) % combs[l];
+                p = unarray[b + ps[x]];
+                q = unarray[b + qs[x]];
+            }
+            if (permit[p][q]) {
                 break;
             }
         }
     }
 
-    std::ofstream output_file(argv[1]);
-    output_file << nomuls << " " << flips << " " << rcode << " " << target << " " << flimit << " ";
-    output_file << plimit << " " << termination << " " << rseed << " " << symm << " " << maxplus << " ";
-    output_file << achieved << " " << minmuls << " " << plus << "\n";
-    if (minmuls < achieved) {
-        for (vlong m : best) {
-            output_file << m << "\n";
+    // Chance of reducing from rank r to target within budget flips, each rank taking a geometric number of flips.
+    // The budget is split into cells and the distribution of flips used is carried down one rank at a time.
+    double chance(int r, vlong budget) {
+        const int cells = 1024;
+        std::vector<double> p(cells, 0.0);
+        p[0] = 1;
+        double h = (double)budget / cells;
+        for (; r > target; r -= symm) {
+            double a = r < (int)rates.size() ? 1 - std::exp(-rates[r] * h) : 1;
+            double q = 0;
+            for (int j = 0; j < cells; j++) {
+                q = a * p[j] + (1 - a) * q;
+                p[j] = q;
+            }
         }
+        double c = 0;
+        for (double x : p) {
+            c += x;
+        }
+        return c;
     }
-    else {
-        for (vlong m : muls) {
-            output_file << m << "\n";
+
+    // Switch on predictive termination with the given threshold and rates.
+    void setpredict(double pr, std::vector<double>& rs) {
+        predict = pr;
+        rates = rs;
+        pfresh = chance(achieved, flimit);
+        predictgap = flimit / 32 > 10000 ? flimit / 32 : 10000;
+        predictby = flips + predictgap;
+    }
+
+    // Publish live metrics to lane k of m from now on.
+    void setmetrics(fgmetrics* m, int k) {
+        metrics = m;
+        lane = k;
+        mflips = flips;
+        mplus = plus;
+        metricsby = flips;
+    }
+
+    // Log to flight recorder r from now on.
+    void setrecorder(fgrecorder* r) {
+        recorder = r;
+        recordby = flips;
+    }
+
+    // Log a checkpoint of the rank and state hash.
+    void checkpoint() {
+        recordby = flips + fgrecorder::gap;
+        if (!hashing) {
+            fullhash();
+        }
+        recorder->event(flips, fgrecorder::checkpoint, achieved, hash);
+    }
+
+    // Publish the flips and plus transitions since the last time and the current state to the live metrics.
+    void publish() {
+        metricsby = flips + fgmetrics::gap;
+        metrics->add(lane, flips - mflips, plus - mplus, achieved, minmuls, (int)twoplusl.size(), uniques.size(), flips - reach.back());
+        mflips = flips;
+        mplus = plus;
+    }
+
+    // Set flips at which next plus transition is due.
+    inline void setplusby() {
+        if (achieved >= maxplus) {
+            plusby = flimit * 1007;
+        }
+        else if ((long long)plimit < 0) {
+            plusby = flips + symm + mt() % (-2 * (long long)plimit);
+        }
+        else {
+            plusby = flips + plimit;
         }
     }
 
-    delete[] unarray;
+    // Bookkeeping after a reduction, returns non-zero if the walk is complete.
+    int reduced(int s) {
+        achieved -= symm;
+        reductions++;
+        if (recorder != NULL) {
+            recorder->event(flips, fgrecorder::reduction, s, achieved);
+        }
+        if (lookby > 0 && achieved < lookfrom) {
+            endlook(true);
+        }
+        if (achieved < minmuls) {
+            if (!checkprint()) return 1;
+            minmuls = achieved;
+            reach.push_back(flips);
+            if (achieved > target) {
+                limit = updatelimit(limit, flips, termination, split, achieved, target, symm, flimit);
+            }
+        }
+        if (achieved <= minmuls) {
+            savebest();
+        }
+        setplusby();
+        if (twoplusl.size() == 0) {
+            rcode = -1;
+            return 1;
+        }
+        if (achieved <= target) {
+            return 1;
+        }
+        bool trigger = true;
+        for (int j = 0; j < twoplusl.size(); j++) {
+            vlong v = twoplusl[j];
+            int b = uniques.getvalue(v);
+            int t = unarray[b + 1] / symm;
+            for (int i = 1; i < unarray[b]; i++) {
+                int u = unarray[b + i + 1] / symm;
+                if (t != u) {
+                    trigger = false;
+                }
+            }
+        }
+        if (trigger) {
+            plusby = flips;
+        }
+        return 0;
+    }
+
+    // Write state in the interface file format.
+    void write(const char* fname, int code, std::vector<vlong>& m, vlong h) {
+        std::ofstream output_file(fname);
+        write(output_file, code, m, h);
+    }
+
+    // Write state in the interface file format to a stream.
+    void write(std::ostream& output_file, int code, std::vector<vlong>& m, vlong h) {
+        output_file << nomuls << " " << flips << " " << code << " " << target << " " << flimit << " ";
+        output_file << plimit << " " << termination << " " << rseed << " " << symm << " " << maxplus << " ";
+        output_file << achieved << " " << minmuls << " " << plus << " " << reductions << " " << greedyflips << " " << h << " " << swaps << " " << branches << "\n";
+        for (vlong x : m) {
+            output_file << x << "\n";
+        }
+        if (!reach.empty()) {
+            output_file << minmuls + symm * (reach.size() - 1) << " " << reach.size();
+            for (vlong x : reach) {
+                output_file << " " << x;
+            }
+            output_file << "\n";
+        }
+    }
+
+    // Write the current state to the recovery file, if there is one.
+    void dump() {
+        if (!dumpfile.empty()) {
+            if (!hashing) {
+                fullhash();
+            }
+            write(dumpfile.c_str(), 2, muls, hash);
+        }
+    }
+
+    // Write recovery file if due.
+    inline void checkrecovery() {
+        if (flips >= recovery) {
+            recovery += 5000000000;
+            dump();
+        }
+    }
+
+    // Act on stop and snapshot requests and the wall clock deadline, returns non-zero if the walk is to stop.
+    int poll() {
+        pollby = flips + pollgap;
+        int n = fgsnapshots.load(std::memory_order_relaxed);
+        if (n != snapshots) {
+            snapshots = n;
+            dump();
+        }
+        if (fgstopping.load(std::memory_order_relaxed)) {
+            rcode = 7;
+            return 1;
+        }
+        if (timed && std::chrono::steady_clock::now() >= deadline) {
+            rcode = 8;
+            return 1;
+        }
+        return 0;
+    }
+
+    // Test for termination on flip limit, returns non-zero if the walk is complete.
+    inline int checklimit() {
+        if (flips >= metricsby) {
+            publish();
+        }
+        if (flips >= recordby) {
+            checkpoint();
+        }
+        if (flips >= pollby && poll()) {
+            return 1;
+        }
+        if (predictby > 0 && flips >= predictby) {
+            predictby = flips + predictgap;
+            if (limit <= flips || chance(minmuls, limit - flips) < predict * pfresh) {
+                rcode = 2;
+                return 1;
+            }
+        }
+        if ((pool != NULL || shared != NULL) && minmuls < published) {
+            published = minmuls;
+            if (pool != NULL) {
+                pool->publish(getbest(), minmuls, besthash);
+            }
+            if (shared != NULL) {
+                shared->publish(getbest(), minmuls, besthash);
+            }
+        }
+        if (stop != NULL && stop->load(std::memory_order_relaxed)) {
+            rcode = 2;
+            return 1;
+        }
+        if (flips >= limit) {
+            if (flips >= flimit) {
+                rcode = 1;
+            }
+            else {
+                rcode = 2;
+            }
+            return 1;
+        }
+        return 0;
+    }
+
+    // Plus transition for 3-way cyclic symmetry.
+    void plus3() {
+        checkrecovery();
+        int r;
+        for (r = 0; r < nomuls; r++) {
+            if (muls[r] == 0) break;
+        }
+        int p, q;
+        vlong mpd, mpe, mpf, mqd, mqe, mqf;
+        vlong mpdn, mpen, mpfn, mqdn, mqen, mqfn, mrdn, mren, mrfn;
+        while (true) {
+            p = mt() % nomuls;
+            q = mt() % nomuls;
+            mpd = muls[p];
+            mpe = muls[me[p]];
+            mpf = muls[mf[p]];
+            mqd = muls[q];
+            mqe = muls[me[q]];
+            mqf = muls[mf[q]];
+            mpdn = mpd;
+            mpen = mpe ^ mqe;
+            mpfn = mpf;
+            mqdn = mpd;
+            mqen = mqe;
+            mqfn = mpf ^ mqf;
+            mrdn = mpd ^ mqd;
+            mren = mqe;
+            mrfn = mqf;
+            bool ok = true;
+            if (maxsize > 0) {
+                int psize = bitcount(mpdn) * bitcount(mpen) * bitcount(mpfn);
+                int qsize = bitcount(mqdn) * bitcount(mqen) * bitcount(mqfn);
+                int rsize = bitcount(mrdn) * bitcount(mren) * bitcount(mrfn);
+                if (psize > maxsize || qsize > maxsize || rsize > maxsize) {
+                    ok = false;
+                }
+            }
+            else if (maxsize < 0) {
+                if (!(bitlimit(mpen, exceed) && bitlimit(mqfn, exceed) && bitlimit(mrdn, exceed))) {
+                    ok = false;
+                }
+            }
+            if (mpd == 0 || mqd == 0) ok = false;
+            if (mpd == mqd || mpe == mqe || mpf == mqf) ok = false;
+            if (!permit[p][q]) ok = false;
+            if (ok) break;
+        }
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mpd);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, r, mrdn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[r], mqe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[r], mqf);
+        setmul(p, mpdn);
+        setmul(me[p], mpen);
+        setmul(mf[p], mpfn);
+        setmul(q, mqdn);
+        setmul(me[q], mqen);
+        setmul(mf[q], mqfn);
+        setmul(r, mrdn);
+        setmul(me[r], mren);
+        setmul(mf[r], mrfn);
+        plus += 3;
+        achieved += 3;
+        setplusby();
+        if (recorder != NULL) {
+            recorder->event(flips, fgrecorder::plusevent, p, q, r);
+        }
+    }
+
+    // Plus transition for 6-way cyclic plus reflective symmetry.
+    void plus6() {
+        checkrecovery();
+        int r;
+        for (r = 0; r < nomuls; r++) {
+            if (muls[r] == 0) break;
+        }
+        int rr = r + 3;
+        int p, q, pp, qq;
+        vlong mpd, mpe, mpf, mqd, mqe, mqf;
+        vlong mpdn, mpen, mpfn, mqdn, mqen, mqfn, mrdn, mren, mrfn;
+        vlong mppd, mppe, mppf, mqqd, mqqe, mqqf;
+        vlong mppdn, mppen, mppfn, mqqdn, mqqen, mqqfn, mrrdn, mrren, mrrfn;
+        while (true) {
+            p = mt() % nomuls;
+            q = mt() % nomuls;
+            int x = p % 6;
+            if (x < 3) {
+                pp = p + 3;
+            }
+            else {
+                pp = p - 3;
+            }
+            x = q % 6;
+            if (x < 3) {
+                qq = q + 3;
+            }
+            else {
+                qq = q - 3;
+            }
+            mpd = muls[p];
+            mpe = muls[me[p]];
+            mpf = muls[mf[p]];
+            mqd = muls[q];
+            mqe = muls[me[q]];
+            mqf = muls[mf[q]];
+            mpdn = mpd;
+            mpen = mpe ^ mqe;
+            mpfn = mpf;
+            mqdn = mpd;
+            mqen = mqe;
+            mqfn = mpf ^ mqf;
+            mrdn = mpd ^ mqd;
+            mren = mqe;
+            mrfn = mqf;
+            mppd = muls[pp];
+            mppe = muls[me[pp]];
+            mppf = muls[mf[pp]];
+            mqqd = muls[qq];
+            mqqe = muls[me[qq]];
+            mqqf = muls[mf[qq]];
+            mppdn = mppd;
+            mppen = mppe ^ mqqe;
+            mppfn = mppf;
+            mqqdn = mppd;
+            mqqen = mqqe;
+            mqqfn = mppf ^ mqqf;
+            mrrdn = mppd ^ mqqd;
+            mrren = mqqe;
+            mrrfn = mqqf;
+            bool ok = true;
+            if (maxsize > 0) {
+                int psize = bitcount(mpdn) * bitcount(mpen) * bitcount(mpfn);
+                int qsize = bitcount(mqdn) * bitcount(mqen) * bitcount(mqfn);
+                int rsize = bitcount(mrdn) * bitcount(mren) * bitcount(mrfn);
+                if (psize > maxsize || qsize > maxsize || rsize > maxsize) {
+                    ok = false;
+                }
+            }
+            else if (maxsize < 0) {
+                if (!(bitlimit(mpen, exceed) && bitlimit(mqfn, exceed) && bitlimit(mrdn, exceed))) {
+                    ok = false;
+                }
+            }
+            if (mpd == 0 || mqd == 0) ok = false;
+            if (mppd == 0 || mqqd == 0) ok = false;
+            if (mpd == mqd || mpe == mqe || mpf == mqf) ok = false;
+            if (mppd == mqqd || mppe == mqqe || mppf == mqqf) ok = false;
+            if (!permit[p][q]) ok = false;
+            if (ok) break;
+        }
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mpd);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, r, mrdn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[r], mqe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[r], mqf);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mqqd);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mppd);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, rr, mrrdn);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[rr], mqqe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[rr], mqqf);
+        setmul(p, mpdn);
+        setmul(me[p], mpen);
+        setmul(mf[p], mpfn);
+        setmul(q, mqdn);
+        setmul(me[q], mqen);
+        setmul(mf[q], mqfn);
+        setmul(r, mrdn);
+        setmul(me[r], mren);
+        setmul(mf[r], mrfn);
+        setmul(pp, mppdn);
+        setmul(me[pp], mppen);
+        setmul(mf[pp], mppfn);
+        setmul(qq, mqqdn);
+        setmul(me[qq], mqqen);
+        setmul(mf[qq], mqqfn);
+        setmul(rr, mrrdn);
+        setmul(me[rr], mrren);
+        setmul(mf[rr], mrrfn);
+        plus += 6;
+        achieved += 6;
+        setplusby();
+        if (recorder != NULL) {
+            recorder->event(flips, fgrecorder::plusevent, p, q, r);
+        }
+    }
+
+    // One flip for 3-way cyclic symmetry, returns non-zero if the walk is complete.
+    int step3() {
+        flips += 3;
+        int from = achieved;
+        int mark = jslots.size();
+
+        int p, q;
+        if (greedy > 0 && gps.size() > 0 && (int)(mt() % 100) < greedy && greedysample(p, q)) {
+            greedyflips++;
+        }
+        else if (maxsize == 0) {
+            sample(p, q);
+        }
+        else if (!sizesample(p, q)) {
+            rcode = 6;
+            return 1;
+        }
+        vlong mpe = muls[me[p]];
+        vlong mpf = muls[mf[p]];
+        vlong mqe = muls[me[q]];
+        vlong mqf = muls[mf[q]];
+        vlong mpen = mqe ^ mpe;
+        vlong mqfn = mqf ^ mpf;
+
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+        setmul(me[p], mpen);
+
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+        setmul(mf[q], mqfn);
+
+        if (mpen == 0) {
+            vlong mpd = muls[p];
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, p, mpd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[p], mpf);
+            setmul(p, 0);
+            setmul(mf[p], 0);
+            if (reduced(p)) return 1;
+        }
+
+        if (mqfn == 0) {
+            vlong mqd = muls[q];
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[q], mqe);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+            setmul(q, 0);
+            setmul(me[q], 0);
+            if (reduced(q)) return 1;
+        }
+
+        // A step back into the tabu window is undone, the walk still taking its plus transitions as it would have.
+        int rejected = 0;
+        if (tabu > 0) {
+            if (achieved == from && tabuseen(hash)) {
+                rollback(mark);
+                tabuhits++;
+                rejected = 1;
+            }
+            else {
+                tabupush(hash);
+            }
+        }
+
+        if (greedy > 0 && !rejected) {
+            collide(me[p]);
+            collide(mf[q]);
+        }
+
+        if (flips >= plusby) {
+            if (lookahead > 0 && lookby == 0) {
+                startlook();
+            }
+            plus3();
+            if (greedy > 0) {
+                collideall();
+            }
+            if (!checkprint()) return 1;
+        }
+
+        if (sentinel > 0 && fprint != fingerprint) {
+            rcode = 5;
+            return 1;
+        }
+
+        if (journal) {
+            if (lookby > 0) {
+                if (flips >= lookby) {
+                    endlook(false);
+                }
+            }
+            else if (backtrack > 0) {
+                if (flips - bestflips >= backtrack) {
+                    tobest();
+                }
+                trimjournal();
+            }
+            else if (tabu > 0) {
+                jslots.clear();
+                jvals.clear();
+            }
+        }
+
+        return checklimit();
+    }
+
+    // One flip for 6-way cyclic plus reflective symmetry, returns non-zero if the walk is complete.
+    int step6() {
+        flips += 6;
+        int from = achieved;
+        int mark = jslots.size();
+
+        int p, q;
+        if (greedy > 0 && gps.size() > 0 && (int)(mt() % 100) < greedy && greedysample(p, q)) {
+            greedyflips++;
+        }
+        else if (maxsize == 0) {
+            sample(p, q);
+        }
+        else if (!sizesample(p, q)) {
+            rcode = 6;
+            return 1;
+        }
+        vlong mpd = muls[p];
+        vlong mpe = muls[me[p]];
+        vlong mpf = muls[mf[p]];
+        vlong mqd = muls[q];
+        vlong mqe = muls[me[q]];
+        vlong mqf = muls[mf[q]];
+        vlong mpen = mqe ^ mpe;
+        vlong mqfn = mqf ^ mpf;
+
+        int x = p % 6;
+        int pp;
+        if (x < 3) {
+            pp = p + 3;
+        }
+        else {
+            pp = p - 3;
+        }
+        x = q % 6;
+        int qq;
+        if (x < 3) {
+            qq = q + 3;
+        }
+        else {
+            qq = q - 3;
+        }
+
+        vlong mppd = muls[pp];
+        vlong mppe = muls[me[pp]];
+        vlong mppf = muls[mf[pp]];
+        vlong mqqd = muls[qq];
+        vlong mqqe = muls[me[qq]];
+        vlong mqqf = muls[mf[qq]];
+        vlong mppen = mqqe ^ mppe;
+        vlong mqqfn = mqqf ^ mppf;
+
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+        setmul(me[p], mpen);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppe);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
+        setmul(me[pp], mppen);
+
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+        setmul(mf[q], mqfn);
+        flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqf);
+        flipadd(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
+        setmul(mf[qq], mqqfn);
+
+        if (mpen == 0 || (mpd == mppd && mpen == mppen && mpf == mppf)) {
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, p, mpd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[p], mpen);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[p], mpf);
+            setmul(p, 0);
+            setmul(mf[p], 0);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, pp, mppd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[pp], mppen);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[pp], mppf);
+            setmul(pp, 0);
+            setmul(mf[pp], 0);
+            if (mpen != 0) {
+                setmul(me[p], 0);
+                setmul(me[pp], 0);
+            }
+            if (reduced(p)) return 1;
+        }
+
+        if (mqfn == 0 || (mqd == mqqd && mqe == mqqe && mqfn == mqqfn)) {
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, q, mqd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[q], mqe);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[q], mqfn);
+            setmul(q, 0);
+            setmul(me[q], 0);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, qq, mqqd);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, me[qq], mqqe);
+            flipdel(unarray, avail, nomuls, uniques, twoplusd, twoplusl, mf[qq], mqqfn);
+            setmul(qq, 0);
+            setmul(me[qq], 0);
+            if (mqfn != 0) {
+                setmul(mf[q], 0);
+                setmul(mf[qq], 0);
+            }
+            if (reduced(q)) return 1;
+        }
+
+        // A step back into the tabu window is undone, the walk still taking its plus transitions as it would have.
+        int rejected = 0;
+        if (tabu > 0) {
+            if (achieved == from && tabuseen(hash)) {
+                rollback(mark);
+                tabuhits++;
+                rejected = 1;
+            }
+            else {
+                tabupush(hash);
+            }
+        }
+
+        if (greedy > 0 && !rejected) {
+            collide(me[p]);
+            collide(mf[q]);
+        }
+
+        if (flips >= plusby) {
+            if (lookahead > 0 && lookby == 0) {
+                startlook();
+            }
+            plus6();
+            if (greedy > 0) {
+                collideall();
+            }
+            if (!checkprint()) return 1;
+        }
+
+        if (sentinel > 0 && fprint != fingerprint) {
+            rcode = 5;
+            return 1;
+        }
+
+        if (journal) {
+            if (lookby > 0) {
+                if (flips >= lookby) {
+                    endlook(false);
+                }
+            }
+            else if (backtrack > 0) {
+                if (flips - bestflips >= backtrack) {
+                    tobest();
+                }
+                trimjournal();
+            }
+            else if (tabu > 0) {
+                jslots.clear();
+                jvals.clear();
+            }
+        }
+
+        return checklimit();
+    }
+
+    // Scheme to return at the end of the walk with its hash, sets rcode 5 if it fails the fingerprint check.
+    std::vector<vlong>& result(vlong& h) {
+        if (metrics != NULL) {
+            publish();
+        }
+        if (recorder != NULL) {
+            recorder->event(flips, fgrecorder::end, rcode + 1, minmuls);
+        }
+        if (rcode != 5 && minmuls < achieved) {
+            if (schemeprint(getbest()) == fingerprint) {
+                h = besthash;
+                return best;
+            }
+            rcode = 5;
+        }
+        else if (rcode != 5 && checkprint()) {
+            fullhash();
+            h = hash;
+            return muls;
+        }
+        h = 0;
+        return muls;
+    }
+
+    // Set up backtracking and tabu before the first step, returns non-zero if the walk is already complete
+    // because no two components are equal, so there is no flip to take.
+    int start() {
+        if (twoplusl.size() == 0) {
+            rcode = -1;
+            return 1;
+        }
+        if (backtrack > 0) {
+            journal = true;
+            jbest = true;
+            hashing = true;
+        }
+        if (tabu > 0) {
+            journal = true;
+            hashing = true;
+            if (tabu > 65536) {
+                tabu = 65536;
+            }
+            tabumask = 1;
+            while (tabumask < 4 * tabu) {
+                tabumask *= 2;
+            }
+            tabukeys.assign(tabumask, 0);
+            tabucounts.assign(tabumask, 0);
+            tabumask--;
+            taburing.reserve(tabu);
+            tabupush(hash);
+        }
+        return 0;
+    }
+
+    // Run the walk until target, flip limit or no flips available.
+    void run() {
+        if (start()) {
+            return;
+        }
+        if (symm == 3) {
+            while (!step3());
+        }
+        if (symm == 6) {
+            while (!step6());
+        }
+    }
+
+    // Run the walk for at least n more flips or until it reaches the branching rank, returns non-zero if the walk is complete.
+    int runfor(vlong n) {
+        if (rcode == -1) {
+            return 1;
+        }
+        vlong until = flips + n;
+        while (flips < until) {
+            if (symm == 3 ? step3() : step6()) {
+                return 1;
+            }
+            if (minmuls <= branchat) {
+                return 0;
+            }
+        }
+        return 0;
+    }
+};
+
+// Settings from the interface file header, the fields after maxsize are optional.
+struct fgsettings {
+    int nomuls, rcode, target, rseed, symm, maxplus, minmuls, maxsize, termination, split;
+    vlong flips, flimit, plimit;
+    int lookahead = 0;
+    vlong backtrack = 0;
+    int greedy = 0;
+    int tabu = 0;
+    int sentinel = 0;
+    int walkers = 1;
+    int restarts = 0;
+    std::string shared = "-";
+    int replicas = 1;
+    vlong swapint = 100000;
+    long long master = -1;
+    vlong run = 0;
+    int hugepages = 0;
+    int affinity = -1;
+    int hold = 0;
+    int forks = 0;
+    vlong stage = 0;
+    int within = 0;
+    int branches = 0;
+    double predict = 0;
+    double metrics = 0;
+    std::string metricsfile = "-";
+    double timelimit = 0;
+    std::string record = "-";
+    std::vector<double> rates;
+    fgmetrics* monitor = NULL;
+    std::chrono::steady_clock::time_point deadline;
+};
+
+// Outcome of one walker over all its restarts, or of a whole solve.
+struct fgresult {
+    std::vector<vlong> muls;
+    int rank, rcode;
+    int achieved = 0;
+    std::vector<vlong> reach;           // Flips on reaching each rank, as fgwalk::reach, only for a single walk.
+    vlong hash = 0;
+    vlong flips = 0;
+    vlong plus = 0;
+    vlong reductions = 0;
+    vlong greedyflips = 0;
+    vlong swaps = 0;
+    vlong branches = 0;
+};
+
+// Set the optional walk settings, the walk publishing metrics in the given lane.
+void setoptions(fgwalk& walk, fgsettings& set, int lane = 0) {
+    walk.lookahead = set.lookahead;
+    walk.backtrack = set.backtrack;
+    walk.tabu = set.tabu;
+    walk.sentinel = set.sentinel;
+    if (set.predict > 0 && !set.rates.empty()) {
+        walk.setpredict(set.predict, set.rates);
+    }
+    if (set.monitor != NULL) {
+        walk.setmetrics(set.monitor, lane);
+    }
+    if (set.timelimit > 0) {
+        walk.timed = true;
+        walk.deadline = set.deadline;
+    }
+}
+
+// Pin the calling thread to a CPU, counting round the CPUs available, cpu < 0 leaves it free.  Linux only.
+void pinthread(int cpu) {
+#ifdef __linux__
+    if (cpu >= 0) {
+        int n = std::thread::hardware_concurrency();
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu % (n > 0 ? n : 1), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#endif
+}
+
+// One of several walkers, restarting from the elite pool each time it reaches its flip limit.
+void walker(int k, fgsettings& set, std::vector<vlong>& initial, fgpool& pool, fgshared* shared, std::atomic<int>& stop, fgresult& res) {
+    pinthread(set.affinity < 0 ? -1 : set.affinity + k);
+    std::mt19937 mt(streamseed(set.master, set.run, k + (set.stage << 16), -1));
+    std::vector<vlong> start = initial;
+    res.rank = set.nomuls + 1;
+    res.rcode = 9;
+    bool discard = false;
+    for (int j = 0; j <= set.restarts && !stop; j++) {
+        if (j > 0 && (discard || ((shared == NULL || !shared->sample(start, mt)) && !pool.sample(start, set.symm, mt)))) {
+            start = initial;
+        }
+        discard = false;
+        fgwalk walk(start, 0, set.target, set.flimit, set.plimit, set.termination, streamseed(set.master, set.run, k + (set.stage << 16), j), set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+        setoptions(walk, set, k);
+        walk.pool = &pool;
+        walk.shared = shared;
+        walk.stop = &stop;
+        // A pool scheme failing the check is discarded and the restart made from the initial scheme instead,
+        // only a walk that has gone wrong itself counts as divergence.
+        if (walk.schemeprint(initial) != walk.fingerprint) {
+            if (start != initial) {
+                discard = true;
+                j--;
+                continue;
+            }
+            walk.rcode = 5;
+        }
+        else {
+            walk.run();
+        }
+        vlong h;
+        std::vector<vlong>& out = walk.result(h);
+        res.flips += walk.flips;
+        res.plus += walk.plus;
+        res.reductions += walk.reductions;
+        res.greedyflips += walk.greedyflips;
+        if (walk.rcode == 5) {
+            res.rcode = 5;
+            stop = 1;
+            return;
+        }
+        if (walk.minmuls < res.rank) {
+            res.muls = out;
+            res.rank = walk.minmuls;
+            res.hash = h;
+            res.rcode = walk.rcode;
+        }
+        if (walk.minmuls <= set.target) {
+            stop = 1;
+        }
+        if (walk.rcode != 1 && walk.rcode != 2) {
+            return;
+        }
+    }
+}
+
+// Replica exchange, walks with plus transition intervals spaced by factors of two around plimit run in parallel
+// for swapint flips at a time.  Between rounds neighbouring replicas exchange intervals, always if the one doing
+// more plus transitions has the lower rank and otherwise with probability halving for every symm ranks it is
+// higher, so low rank schemes drift towards the rarer plus transitions and high rank ones towards the frequent.
+void temper(fgsettings& set, std::vector<vlong>& initial, fgshared* shared, fgresult& res) {
+    int n = set.replicas;
+    std::mt19937 mt(streamseed(set.master, set.run, n + (set.stage << 16), -1));
+    std::vector<fgwalk*> walks(n, NULL);
+    std::vector<vlong> rates(n);
+    std::vector<int> rung(n);
+    std::vector<int> done(n, 0);
+    // plimit holds a negative interval for random plus transitions, so the ladder scales its magnitude and keeps the sign.
+    long long interval = (long long)set.plimit;
+    double magnitude = std::fabs((double)interval);
+    for (int k = 0; k < n; k++) {
+        long long r = (long long)std::min(std::max(std::ldexp(magnitude, (n - 1) / 2 - k), 1.0), std::ldexp(1.0, 62));
+        rates[k] = (vlong)(interval < 0 ? -r : r);
+        rung[k] = k;
+    }
+    bool finished = false;
+    for (int round = 0; !finished; round++) {
+        std::vector<std::thread> threads;
+        for (int k = 0; k < n; k++) {
+            if (!done[k]) {
+                threads.push_back(std::thread([&walks, &done, &rates, &set, &initial, shared, k]() {
+                    pinthread(set.affinity < 0 ? -1 : set.affinity + k);
+                    if (walks[k] == NULL) {
+                        walks[k] = new fgwalk(initial, 0, set.target, set.flimit, rates[k], set.termination, streamseed(set.master, set.run, k + (set.stage << 16), 0), set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+                        setoptions(*walks[k], set, k);
+                        walks[k]->shared = shared;
+                        walks[k]->start();
+                    }
+                    done[k] = walks[k]->runfor(set.swapint);
+                }));
+            }
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        finished = true;
+        for (int k = 0; k < n; k++) {
+            if (!done[k]) {
+                finished = false;
+            }
+            else if (walks[k]->rcode == 5 || walks[k]->minmuls <= set.target) {
+                finished = true;
+                break;
+            }
+        }
+        for (int r = round % 2; !finished && r + 1 < n; r += 2) {
+            fgwalk* cold = walks[rung[r]];
+            fgwalk* hot = walks[rung[r + 1]];
+            if (done[rung[r]] || done[rung[r + 1]]) {
+                continue;
+            }
+            int d = (hot->achieved - cold->achieved) / set.symm;
+            if (d <= 0 || (d < 32 && (mt() & ((1u << d) - 1)) == 0)) {
+                std::swap(cold->plimit, hot->plimit);
+                cold->setplusby();
+                hot->setplusby();
+                std::swap(rung[r], rung[r + 1]);
+                res.swaps++;
+            }
+        }
+    }
+    res.rank = set.nomuls + 1;
+    res.rcode = 9;
+    for (int k = 0; k < n; k++) {
+        fgwalk* walk = walks[k];
+        if (!done[k]) {
+            walk->rcode = 2;
+        }
+        vlong h;
+        std::vector<vlong>& out = walk->result(h);
+        res.flips += walk->flips;
+        res.plus += walk->plus;
+        res.reductions += walk->reductions;
+        res.greedyflips += walk->greedyflips;
+        if (walk->rcode == 5) {
+            res.rcode = 5;
+        }
+        else if (res.rcode != 5 && walk->minmuls < res.rank) {
+            res.muls = out;
+            res.rank = walk->minmuls;
+            res.hash = h;
+            res.rcode = walk->rcode;
+        }
+        delete walk;
+    }
+}
+
+// Add a finished walk to a result, flips counted from base.
+void collect(fgwalk* walk, vlong base, fgresult& res) {
+    vlong h;
+    std::vector<vlong>& out = walk->result(h);
+    res.flips += walk->flips - base;
+    res.plus += walk->plus;
+    res.reductions += walk->reductions;
+    res.greedyflips += walk->greedyflips;
+    if (walk->rcode == 5) {
+        res.rcode = 5;
+    }
+    else if (res.rcode != 5 && walk->minmuls < res.rank) {
+        res.muls = out;
+        res.rank = walk->minmuls;
+        res.hash = h;
+        res.rcode = walk->rcode;
+    }
+}
+
+// Branching, a single walk runs until its lowest rank is within set.within of target, then it is cloned from its
+// best scheme, counters included, into set.branches walks with streams of their own.  Walks run in parallel in
+// slices of a million flips, stopping early to branch.  After each slice walks behind the lowest rank or out of
+// flips are pruned, and a walk reaching a new lowest rank branches into the places freed.
+void branch(fgsettings& set, std::vector<vlong>& initial, fgshared* shared, fgresult& res) {
+    std::vector<fgwalk*> walks;
+    std::vector<vlong> base;
+    res.rank = set.nomuls + 1;
+    res.rcode = 9;
+    walks.push_back(new fgwalk(initial, 0, set.target, set.flimit, set.plimit, set.termination, streamseed(set.master, set.run, (set.stage + 2) << 16, 0), set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages));
+    base.push_back(0);
+    setoptions(*walks[0], set);
+    walks[0]->shared = shared;
+    walks[0]->branchat = set.target + set.within;
+    walks[0]->start();
+    while (!walks.empty()) {
+        int n = walks.size();
+        std::vector<int> done(n, 0);
+        std::vector<std::thread> threads;
+        for (int k = 0; k < n; k++) {
+            walks[k]->lane = k;
+            threads.push_back(std::thread([&walks, &done, k]() { done[k] = walks[k]->runfor(1000000); }));
+        }
+        for (std::thread& t : threads) {
+            t.join();
+        }
+        bool finished = false;
+        int low = set.nomuls;
+        for (int k = 0; k < n; k++) {
+            if (walks[k]->rcode == 5 || walks[k]->minmuls <= set.target) {
+                finished = true;
+            }
+            if (walks[k]->minmuls < low) {
+                low = walks[k]->minmuls;
+            }
+        }
+        std::vector<fgwalk*> kept;
+        std::vector<vlong> keptbase;
+        for (int k = 0; k < n; k++) {
+            if (finished || done[k] || walks[k]->minmuls > low) {
+                if (!done[k]) {
+                    walks[k]->rcode = 2;
+                }
+                collect(walks[k], base[k], res);
+                delete walks[k];
+            }
+            else {
+                kept.push_back(walks[k]);
+                keptbase.push_back(base[k]);
+            }
+        }
+        for (int k = 0; k < (int)kept.size(); k++) {
+            fgwalk* walk = kept[k];
+            if (walk->minmuls > walk->branchat) {
+                continue;
+            }
+            walk->branchat = walk->minmuls - set.symm;
+            while ((int)kept.size() < set.branches) {
+                int rs = streamseed(set.master, set.run, ((set.stage + 2) << 16) + res.branches + 1, 0);
+                fgwalk* c = new fgwalk(walk->getbest(), walk->flips, set.target, set.flimit, walk->plimit, set.termination, rs, set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+                setoptions(*c, set);
+                c->shared = shared;
+                c->limit = walk->limit;
+                c->branchat = walk->branchat;
+                c->start();
+                kept.push_back(c);
+                keptbase.push_back(walk->flips);
+                res.branches++;
+            }
+        }
+        walks = kept;
+        base = keptbase;
+    }
+}
+
+// Scheme text format, one multiplication per line, (a13+a32)*(b12+b21)*(c13+c25) over GF(2), or signed with integer
+// coefficients as in the lifted files, (a13 - a32) (b12 + 2*b21) c13, the * after a coefficient being optional.  Entries map to bits through the row and column
+// orders of setrco in MatrixMult22.py, with C transposed (trans) or not as in loadsol and writesol there.
+class fgformat {
+public:
+    int n, size;
+    int odr[3][64];
+    char labels[3][64][4];
+    int row[3][64], col[3][64];     // Row and column of each bit of the A, B and C masks, in setrco order.
+
+    // Constructor, for n x n matrices, n up to 8, in setrco order 0 to 3.
+    fgformat(int dim, int order, int trans) {
+        n = dim;
+        size = n * n;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < size; j++) {
+                row[i][j] = j / n;
+                col[i][j] = j % n;
+            }
+        }
+        if (order >= 2) {
+            for (int i = 0; i < 3; i++) {
+                int l = 0;
+                for (int k = 0; k < n; k++) {
+                    for (int j = 0; j < k; j++) {
+                        row[i][l] = j;
+                        col[i][l] = k;
+                        l++;
+                    }
+                    for (int j = 0; j < k; j++) {
+                        row[i][l] = k;
+                        col[i][l] = j;
+                        l++;
+                    }
+                    row[i][l] = k;
+                    col[i][l] = k;
+                    l++;
+                }
+            }
+        }
+        if (order == 1 || order == 3) {
+            for (int j = 0; j < size; j++) {
+                row[2][j] = col[1][j];
+                col[2][j] = row[1][j];
+            }
+        }
+        int f[3] = { 0, 1, trans ? 1 : 2 };
+        for (int d = 0; d < 3; d++) {
+            for (int j = 0; j < size; j++) {
+                odr[d][row[f[d]][j] * n + col[f[d]][j]] = j;
+                labels[d][j][0] = 'a' + d;
+                labels[d][j][1] = '1' + row[f[d]][j];
+                labels[d][j][2] = '1' + col[f[d]][j];
+                labels[d][j][3] = 0;
+            }
+        }
+    }
+
+    // Parse schemes from text, appending three masks per multiplication, bits set where the coefficient is odd, and
+    // if coeffs is given the coefficients of each factor, size per factor.  A sign or coefficient before a bracket
+    // applies to everything inside, so -(a13 (b13 - b33) c13) negates all three factors, which negates the product.
+    // Lines without entries are skipped.  Returns the number of multiplications, or -1 with the line number in err
+    // if the text is not a scheme.
+    int parse(const char* p, const char* end, std::vector<vlong>& masks, std::vector<int>* coeffs, int& err) {
+        int count = 0;
+        int line = 1;
+        std::vector<int> c(3 * size, 0);
+        std::vector<int> scale(1, 1);
+        int terms = 0;
+        int sign = 1;
+        int coef = 1;
+        while (true) {
+            int ch = p < end ? *p : '\n';
+            if (ch == '\n' || ch == '\r') {
+                if (terms > 0) {
+                    vlong m[3] = { 0, 0, 0 };
+                    for (int d = 0; d < 3; d++) {
+                        for (int j = 0; j < size; j++) {
+                            m[d] |= (vlong)(c[d * size + j] & 1) << j;
+                        }
+                        masks.push_back(m[d]);
+                    }
+                    if (coeffs != NULL) {
+                        coeffs->insert(coeffs->end(), c.begin(), c.end());
+                    }
+                    std::fill(c.begin(), c.end(), 0);
+                    terms = 0;
+                    count++;
+                }
+                if (p >= end) {
+                    break;
+                }
+                if (ch == '\n' || p + 1 >= end || p[1] != '\n') {
+                    line++;
+                }
+                scale.resize(1);
+                sign = 1;
+                coef = 1;
+                p++;
+            }
+            else if (ch >= 'a' && ch <= 'c') {
+                int r = p + 1 < end ? p[1] - '1' : -1;
+                int k = p + 2 < end ? p[2] - '1' : -1;
+                if (r < 0 || r >= n || k < 0 || k >= n) {
+                    err = line;
+                    return -1;
+                }
+                c[(ch - 'a') * size + odr[ch - 'a'][r * n + k]] += scale.back() * sign * coef;
+                terms++;
+                sign = 1;
+                coef = 1;
+                p += 3;
+            }
+            else if (ch >= '0' && ch <= '9') {
+                coef = 0;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    coef = 10 * coef + *p - '0';
+                    p++;
+                }
+                while (p < end && *p == ' ') {
+                    p++;
+                }
+                if (p < end && *p == '*') {
+                    p++;
+                }
+            }
+            else if (ch == '-') {
+                sign = -sign;
+                p++;
+            }
+            else if (ch == '(') {
+                scale.push_back(scale.back() * sign * coef);
+                sign = 1;
+                coef = 1;
+                p++;
+            }
+            else if (ch == ')') {
+                if (scale.size() > 1) {
+                    scale.pop_back();
+                }
+                p++;
+            }
+            else if (ch == '+' || ch == '*' || ch == ' ' || ch == '\t') {
+                p++;
+            }
+            else {
+                err = line;
+                return -1;
+            }
+        }
+        return count;
+    }
+
+    // Append a multiplication as a line of text, over GF(2) from its three masks, or signed from its coefficients
+    // if c is given.
+    void write(std::string& out, const vlong* m, const int* c) {
+        for (int d = 0; d < 3; d++) {
+            if (c == NULL) {
+                out += d == 0 ? "(" : ")*(";
+                int first = 1;
+                for (int j = 0; j < size; j++) {
+                    if (m[d] >> j & 1) {
+                        if (!first) {
+                            out += '+';
+                        }
+                        out += labels[d][j];
+                        first = 0;
+                    }
+                }
+                continue;
+            }
+            const int* e = c + d * size;
+            int terms = 0;
+            for (int j = 0; j < size; j++) {
+                terms += e[j] != 0;
+            }
+            if (d > 0) {
+                out += ' ';
+            }
+            if (terms > 1) {
+                out += '(';
+            }
+            int first = 1;
+            for (int j = 0; j < size; j++) {
+                if (e[j] == 0) {
+                    continue;
+                }
+                if (first) {
+                    out += e[j] < 0 ? "-" : "";
+                }
+                else {
+                    out += e[j] < 0 ? " - " : " + ";
+                }
+                if (e[j] > 1 || e[j] < -1) {
+                    out += std::to_string(e[j] < 0 ? -e[j] : e[j]);
+                    out += '*';
+                }
+                out += labels[d][j];
+                first = 0;
+            }
+            if (terms > 1) {
+                out += ')';
+            }
+        }
+        out += c == NULL ? ")\n" : "\n";
+    }
+
+    // Set t to the answer tensor, bit a of word b + size * c set where entry a of A times entry b of B is a term of
+    // entry c of C, in the bit order of the masks, as answer() in MatrixMult22.py.
+    void answer(std::vector<vlong>& t) {
+        t.assign(size * size, 0);
+        for (int c = 0; c < size; c++) {
+            for (int b = 0; b < size; b++) {
+                for (int a = 0; a < size; a++) {
+                    if (row[0][a] == row[2][c] && col[0][a] == row[1][b] && col[1][b] == col[2][c]) {
+                        t[b + size * c] |= 1ULL << a;
+                    }
+                }
+            }
+        }
+    }
+
+    // Toggle the tensor of a multiplication in t, bit sliced, the A mask XORed into the word of each pair of set bits
+    // of the B and C masks, as eval in MatrixMult22.py.
+    void toggle(std::vector<vlong>& t, vlong a, vlong b, vlong c) {
+        for (vlong k = c; k; k &= k - 1) {
+            vlong* w = t.data() + size * lowbit(k);
+            for (vlong j = b; j; j &= j - 1) {
+                w[lowbit(j)] ^= a;
+            }
+        }
+    }
+
+    // Terms of a tensor as products of labels, the first most of them and a count of the rest.
+    std::string terms(const std::vector<vlong>& t, int most) {
+        std::string s;
+        int count = 0;
+        for (int c = 0; c < size; c++) {
+            for (int b = 0; b < size; b++) {
+                for (vlong a = t[b + size * c]; a; a &= a - 1) {
+                    if (count++ < most) {
+                        s += s.empty() ? "" : " ";
+                        s += std::string(labels[0][lowbit(a)]) + "*" + labels[1][b] + "*" + labels[2][c];
+                    }
+                }
+            }
+        }
+        if (count > most) {
+            s += " and " + std::to_string(count - most) + " more";
+        }
+        return s;
+    }
+};
+
+// Text of a tensor of n x n matrices drawn as a square, the number of entries in C for each entry of A and B, as
+// matstr in MatrixMult22.py.
+std::string tensorstr(const std::vector<vlong>& t, int n) {
+    int size = n * n;
+    std::string s = "\n";
+    for (int i = 0; i < size; i++) {
+        s += "| ";
+        for (int j = 0; j < size; j++) {
+            int a = 0, f = -1;
+            for (int k = 0; k < size; k++) {
+                if (t[i + size * k] >> j & 1) {
+                    a++;
+                    if (a == 1) {
+                        f = k;
+                    }
+                }
+            }
+            if (a == 0) s += '.';
+            else if (a == 1) s += n > 5 ? '1' : (char)(65 + f);
+            else if (a < 10) s += (char)('0' + a);
+            else s += '*';
+            s += ' ';
+        }
+        s += "|\n";
+    }
+    return s;
+}
+
+// Hensel lifting of a GF(2) scheme to integer coefficients.  The coefficients where the masks are set are taken as
+// odd integers, 1 to start with, a solution mod 2.  Given a solution mod 2^k, one mod 2^(k+1) adds 2^k to some of
+// them, which to add being a linear system over GF(2): the residual of the Brent equations over 2^k, mod 2, must be
+// the sum of the tensors of the multiplications with one factor replaced by a single entry.  The system depends only
+// on the masks, so it is reduced once, its columns as bit packed vectors over the equations, remembering the columns
+// that make up each reduced one, and each step solves it for a new residual by XORing in reduced columns.  The
+// coefficients are kept as the least residues mod 2^(k+1) in absolute value, and the lift stops when they satisfy
+// the equations over the integers.  Unknowns are the coefficients where the masks are set, then the even ones that
+// appear in an equation with them, each step taking the solution whose unknowns come earliest in that order.  Which
+// solution mod 2^(k+1) is taken decides whether the lift ends over the integers, so a lift that does not can be
+// tried again with the unknowns in another order.
+class fglift {
+public:
+    fgformat& format;
+    int size, count;
+    std::vector<vlong> masks;
+    std::vector<int> unknowns;          // Place in the coefficients of each unknown, 3 * size per multiplication.
+    std::vector<int> eqs;               // Equation of each tensor position, or -1 if no unknown appears in it.
+    int words, cwords;                  // Words of a vector over the equations, and over the unknowns.
+    std::vector<vlong> vecs, combs;     // Reduced columns, and the unknowns adding up to each.
+    std::vector<int> pivots;            // Equation of the lowest set bit of each reduced column.
+    std::vector<long long> coeffs;      // Coefficients, 3 * size per multiplication.
+    std::vector<long long> resid;       // Residual of the Brent equations, at each tensor position.
+    std::vector<vlong> answ;
+    int steps = 0;                      // Steps taken, the coefficients being a solution mod 2^(steps+1).
+
+    // Constructor, for the multiplications of a scheme, three masks each, in the bit order of format, with the
+    // unknowns shuffled by seed if it is not 0.
+    fglift(fgformat& f, const std::vector<vlong>& m, int seed) : format(f), masks(m) {
+        size = format.n * format.n;
+        count = (int)masks.size() / 3;
+        format.answer(answ);
+        eqs.assign(size * size * size, -1);
+        int neqs = 0;
+        for (int r = 0; r < count; r++) {
+            for (int d = 0; d < 3; d++) {
+                for (vlong x = masks[3 * r + d]; x; x &= x - 1) {
+                    unknowns.push_back(3 * size * r + d * size + lowbit(x));
+                }
+            }
+            for (vlong a = masks[3 * r]; a; a &= a - 1) {
+                for (vlong b = masks[3 * r + 1]; b; b &= b - 1) {
+                    for (vlong c = masks[3 * r + 2]; c; c &= c - 1) {
+                        int p = lowbit(a) + size * (lowbit(b) + size * lowbit(c));
+                        if (eqs[p] < 0) {
+                            eqs[p] = neqs++;
+                        }
+                    }
+                }
+            }
+        }
+        for (int c = 0; c < size; c++) {
+            for (int b = 0; b < size; b++) {
+                for (vlong a = answ[b + size * c]; a; a &= a - 1) {
+                    int p = lowbit(a) + size * (b + size * c);
+                    if (eqs[p] < 0) {
+                        eqs[p] = neqs++;
+                    }
+                }
+            }
+        }
+        int odd = (int)unknowns.size();
+        std::vector<int> place;
+        for (int r = 0; r < count; r++) {
+            for (int d = 0; d < 3; d++) {
+                for (int i = 0; i < size; i++) {
+                    if ((masks[3 * r + d] >> i & 1) == 0) {
+                        positions(3 * size * r + d * size + i, place);
+                        for (int p : place) {
+                            if (eqs[p] >= 0) {
+                                unknowns.push_back(3 * size * r + d * size + i);
+                                break;
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        for (size_t u = odd; u < unknowns.size(); u++) {
+            positions(unknowns[u], place);
+            for (int p : place) {
+                if (eqs[p] < 0) {
+                    eqs[p] = neqs++;
+                }
+            }
+        }
+        if (seed != 0) {
+            std::mt19937 rng(seed);
+            for (int u = odd - 1; u > 0; u--) {
+                std::swap(unknowns[u], unknowns[rng() % (u + 1)]);
+            }
+            for (int u = (int)unknowns.size() - 1; u > odd; u--) {
+                std::swap(unknowns[u], unknowns[odd + rng() % (u - odd + 1)]);
+            }
+        }
+        words = (neqs + 63) / 64;
+        cwords = ((int)unknowns.size() + 63) / 64;
+        reduce();
+        coeffs.assign(3 * size * count, 0);
+        for (int u = 0; u < odd; u++) {
+            coeffs[unknowns[u]] = 1;
+        }
+    }
+
+    // Tensor positions of the column of the coefficient at place p, the tensor of its multiplication with its factor
+    // replaced by its entry.
+    void positions(int p, std::vector<int>& out) {
+        out.clear();
+        int r = p / (3 * size), d = p % (3 * size) / size, i = p % size;
+        vlong m[3] = { masks[3 * r], masks[3 * r + 1], masks[3 * r + 2] };
+        m[d] = 1ULL << i;
+        for (vlong a = m[0]; a; a &= a - 1) {
+            for (vlong b = m[1]; b; b &= b - 1) {
+                for (vlong c = m[2]; c; c &= c - 1) {
+                    out.push_back(lowbit(a) + size * (lowbit(b) + size * lowbit(c)));
+                }
+            }
+        }
+    }
+
+    // Column of unknown u over the equations.
+    void column(int u, vlong* v, std::vector<int>& place) {
+        std::fill(v, v + words, 0);
+        positions(unknowns[u], place);
+        for (int p : place) {
+            v[eqs[p] >> 6] ^= 1ULL << (eqs[p] & 63);
+        }
+    }
+
+    // Reduce the columns, each against those kept before it, keeping those left non-zero.
+    void reduce() {
+        std::vector<vlong> v(words), c(cwords);
+        std::vector<int> place;
+        for (int u = 0; u < (int)unknowns.size(); u++) {
+            column(u, v.data(), place);
+            std::fill(c.begin(), c.end(), 0);
+            c[u >> 6] |= 1ULL << (u & 63);
+            for (size_t k = 0; k < pivots.size(); k++) {
+                if (v[pivots[k] >> 6] >> (pivots[k] & 63) & 1) {
+                    const vlong* x = vecs.data() + k * words;
+                    for (int w = pivots[k] >> 6; w < words; w++) {
+                        v[w] ^= x[w];
+                    }
+                    const vlong* y = combs.data() + k * cwords;
+                    for (int w = 0; w < cwords; w++) {
+                        c[w] ^= y[w];
+                    }
+                }
+            }
+            int w = 0;
+            while (w < words && v[w] == 0) {
+                w++;
+            }
+            if (w < words) {
+                pivots.push_back(64 * w + lowbit(v[w]));
+                vecs.insert(vecs.end(), v.begin(), v.end());
+                combs.insert(combs.end(), c.begin(), c.end());
+            }
+        }
+    }
+
+    // Set the residual of the Brent equations, the answer less the sum of the tensors of the multiplications.
+    // Returns the number of positions not zero.
+    int residual() {
+        resid.assign(size * size * size, 0);
+        for (int c = 0; c < size; c++) {
+            for (int b = 0; b < size; b++) {
+                for (vlong a = answ[b + size * c]; a; a &= a - 1) {
+                    resid[lowbit(a) + size * (b + size * c)] = 1;
+                }
+            }
+        }
+        std::vector<int> ents[3];
+        for (int r = 0; r < count; r++) {
+            const long long* x = coeffs.data() + 3 * size * r;
+            for (int d = 0; d < 3; d++) {
+                ents[d].clear();
+                for (int i = 0; i < size; i++) {
+                    if (x[d * size + i] != 0) {
+                        ents[d].push_back(i);
+                    }
+                }
+            }
+            for (int a : ents[0]) {
+                for (int b : ents[1]) {
+                    long long ab = x[a] * x[size + b];
+                    for (int c : ents[2]) {
+                        resid[a + size * (b + size * c)] -= ab * x[2 * size + c];
+                    }
+                }
+            }
+        }
+        int nonzero = 0;
+        for (long long x : resid) {
+            nonzero += x != 0;
+        }
+        return nonzero;
+    }
+
+    // Lift until the coefficients satisfy the equations over the integers, at most to a solution mod 2^(most+1).
+    // Returns 1 if they do, 0 if the scheme only lifts mod 2^(steps+1), and -1 if it is not a solution mod 2.
+    int lift(int most) {
+        std::vector<vlong> e(words), x(cwords);
+        for (steps = 0; residual() > 0; steps++) {
+            long long m = 1LL << steps;
+            std::fill(e.begin(), e.end(), 0);
+            for (size_t p = 0; p < resid.size(); p++) {
+                if (resid[p] % (2 * m) != 0) {
+                    return -1;
+                }
+                if (resid[p] / (2 * m) & 1) {
+                    if (eqs[p] < 0) {
+                        return 0;
+                    }
+                    e[eqs[p] >> 6] |= 1ULL << (eqs[p] & 63);
+                }
+            }
+            if (steps == most) {
+                return 0;
+            }
+            std::fill(x.begin(), x.end(), 0);
+            for (size_t k = 0; k < pivots.size(); k++) {
+                if (e[pivots[k] >> 6] >> (pivots[k] & 63) & 1) {
+                    const vlong* v = vecs.data() + k * words;
+                    for (int w = pivots[k] >> 6; w < words; w++) {
+                        e[w] ^= v[w];
+                    }
+                    const vlong* c = combs.data() + k * cwords;
+                    for (int w = 0; w < cwords; w++) {
+                        x[w] ^= c[w];
+                    }
+                }
+            }
+            for (vlong w : e) {
+                if (w != 0) {
+                    return 0;
+                }
+            }
+            for (int u = 0; u < (int)unknowns.size(); u++) {
+                long long& y = coeffs[unknowns[u]];
+                y += (x[u >> 6] >> (u & 63) & 1) * 2 * m;
+                y &= 4 * m - 1;
+                if (y > 2 * m) {
+                    y -= 4 * m;
+                }
+            }
+        }
+        return 1;
+    }
+};
+
+// Convert scheme files to and from masks for MatrixMult22.py, one process for a whole corpus.
+//   --parse n order trans file ...  writes to stdout, for each file a line with its name, number of multiplications
+//                                    and 1 if signed, then a line per multiplication with its masks, and if signed
+//                                    the coefficients of each factor.
+//   --write n order trans           reads the same from stdin and writes each file, signed ones in the lifted form.
+// Names may contain spaces, the last two fields of a name line being the counts.
+int convertschemes(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cerr << "Usage: " << argv[0] << " --parse|--write n order trans [file ...]\n";
+        return 1;
+    }
+    fgformat format(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
+    if (format.n < 1 || format.n > 8) {
+        std::cerr << "Matrix size must be 1 to 8.\n";
+        return 1;
+    }
+    std::string out;
+    std::vector<char> text;
+    std::vector<vlong> masks;
+    std::vector<int> coeffs;
+    if (std::strcmp(argv[1], "--parse") == 0) {
+        for (int i = 5; i < argc; i++) {
+            FILE* f = std::fopen(argv[i], "rb");
+            if (f == NULL) {
+                std::cerr << "Cannot open " << argv[i] << ".\n";
+                return 1;
+            }
+            std::fseek(f, 0, SEEK_END);
+            long len = std::ftell(f);
+            std::fseek(f, 0, SEEK_SET);
+            text.resize(len > 0 ? len : 1);
+            len = (long)std::fread(text.data(), 1, len, f);
+            std::fclose(f);
+            masks.clear();
+            coeffs.clear();
+            int err = 0;
+            int count = format.parse(text.data(), text.data() + len, masks, &coeffs, err);
+            if (count < 0) {
+                std::cerr << "Not a scheme, " << argv[i] << " line " << err << ".\n";
+                return 1;
+            }
+            int sign = 0;
+            for (int x : coeffs) {
+                sign |= x != 0 && x != 1;
+            }
+            out += argv[i];
+            out += ' ' + std::to_string(count) + ' ' + std::to_string(sign) + '\n';
+            for (int k = 0; k < count; k++) {
+                out += std::to_string(masks[3 * k]) + ' ' + std::to_string(masks[3 * k + 1]) + ' ' + std::to_string(masks[3 * k + 2]);
+                for (int j = 0; sign && j < 3 * format.size; j++) {
+                    out += ' ' + std::to_string(coeffs[3 * format.size * k + j]);
+                }
+                out += '\n';
+            }
+            if (out.size() > (1 << 22)) {
+                std::fwrite(out.data(), 1, out.size(), stdout);
+                out.clear();
+            }
+        }
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        return 0;
+    }
+    if (std::strcmp(argv[1], "--write") == 0) {
+        std::ios::sync_with_stdio(false);
+        std::string name;
+        while (std::getline(std::cin, name)) {
+            size_t a = name.find_last_of(' ');
+            size_t b = a == std::string::npos || a == 0 ? std::string::npos : name.find_last_of(' ', a - 1);
+            if (b == std::string::npos) {
+                continue;
+            }
+            int count = std::atoi(name.c_str() + b + 1);
+            int sign = std::atoi(name.c_str() + a + 1);
+            name.resize(b);
+            out.clear();
+            std::vector<vlong> m(3);
+            std::vector<int> c(3 * format.size);
+            for (int k = 0; k < count; k++) {
+                std::cin >> m[0] >> m[1] >> m[2];
+                for (int j = 0; sign && j < 3 * format.size; j++) {
+                    std::cin >> c[j];
+                }
+                format.write(out, m.data(), sign ? c.data() : NULL);
+            }
+            FILE* f = std::fopen(name.c_str(), "wb");
+            if (f == NULL || !std::cin) {
+                std::cerr << "Cannot write " << name << ".\n";
+                return 1;
+            }
+            std::fwrite(out.data(), 1, out.size(), f);
+            std::fclose(f);
+            std::cin.ignore(1, '\n');
+        }
+        return 0;
+    }
+    std::cerr << "Unknown option " << argv[1] << ".\n";
+    return 1;
+}
+
+// Read a solve in the interface file format, the header, the multiplications and any reduction rates.
+void readinput(std::istream& input_file, fgsettings& set, std::vector<vlong>& muls) {
+    std::string header;
+    std::getline(input_file, header);
+    std::istringstream header_fields(header);
+    header_fields >> set.nomuls >> set.flips >> set.rcode >> set.target >> set.flimit >> set.plimit >> set.termination >> set.rseed >> set.symm >> set.maxplus >> set.split >> set.minmuls >> set.maxsize;
+    header_fields >> set.lookahead >> set.backtrack >> set.greedy >> set.tabu >> set.sentinel >> set.walkers >> set.restarts >> set.shared >> set.replicas >> set.swapint >> set.master >> set.run >> set.hugepages >> set.affinity >> set.hold >> set.forks >> set.within >> set.branches >> set.predict >> set.metrics >> set.metricsfile >> set.timelimit >> set.record;
+
+    for (int i = 0; i < set.nomuls; i++) {
+        vlong m;
+        input_file >> m;
+        muls.push_back(m);
+    }
+
+    // Reduction rates for predictive termination follow the multiplications, a count then rank and rate pairs.
+    int nrates = 0;
+    if (input_file >> nrates) {
+        for (int i = 0; i < nrates; i++) {
+            int r;
+            double x;
+            input_file >> r >> x;
+            if (r >= (int)set.rates.size()) {
+                set.rates.resize(r + 1, 0.0);
+            }
+            set.rates[r] = x;
+        }
+    }
+}
+
+// Write the input of a solve in the interface file format, as read by readinput, without the settings for
+// monitoring and stopping it.
+void writeinput(std::ostream& output, fgsettings& set, std::vector<vlong>& muls) {
+    output.precision(17);
+    output << set.nomuls << " " << set.flips << " " << set.rcode << " " << set.target << " " << set.flimit << " " << set.plimit << " " << set.termination << " " << set.rseed << " " << set.symm << " " << set.maxplus << " " << set.split << " " << set.minmuls << " " << set.maxsize;
+    output << " " << set.lookahead << " " << set.backtrack << " " << set.greedy << " " << set.tabu << " " << set.sentinel << " " << set.walkers << " " << set.restarts << " - " << set.replicas << " " << set.swapint << " " << set.master << " " << set.run << " " << set.hugepages << " -1 " << set.hold << " " << set.forks << " " << set.within << " " << set.branches << " " << set.predict << " 0 - 0 -\n";
+    for (vlong m : muls) {
+        output << m << "\n";
+    }
+    int nrates = 0;
+    for (double x : set.rates) {
+        nrates += x != 0;
+    }
+    if (nrates > 0) {
+        output << nrates << "\n";
+        for (int r = 0; r < (int)set.rates.size(); r++) {
+            if (set.rates[r] != 0) {
+                output << r << " " << set.rates[r] << "\n";
+            }
+        }
+    }
+}
+
+// Write the outcome of a solve in the interface file format, as fgwalk::write.
+void writeresult(std::ostream& output, fgsettings& set, fgresult& res) {
+    output << set.nomuls << " " << res.flips << " " << res.rcode << " " << set.target << " " << set.flimit << " ";
+    output << set.plimit << " " << set.termination << " " << set.rseed << " " << set.symm << " " << set.maxplus << " ";
+    output << res.achieved << " " << res.rank << " " << res.plus << " " << res.reductions << " " << res.greedyflips << " " << res.hash << " " << res.swaps << " " << res.branches << "\n";
+    for (vlong x : res.muls) {
+        output << x << "\n";
+    }
+    if (!res.reach.empty()) {
+        output << res.rank + set.symm * (res.reach.size() - 1) << " " << res.reach.size();
+        for (vlong x : res.reach) {
+            output << " " << x;
+        }
+        output << "\n";
+    }
+}
+
+// Run a solve and return its outcome.  The single walk writes a recovery file to dump if it is not empty, and the
+// calling thread is pinned to the affinity CPU if pin is set.
+fgresult solve(fgsettings& set, std::vector<vlong>& muls, const std::string& dump, bool pin) {
+
+    // With a master seed every stream comes from it, the run number and the walker and restart numbers.
+    // Otherwise the single walk keeps the seed given and walkers derive theirs from it.
+    if (set.master >= 0) {
+        set.rseed = streamseed(set.master, set.run, 0, 0);
+    }
+    else {
+        set.master = set.rseed;
+    }
+
+    if (pin) {
+        pinthread(set.affinity);
+    }
+    set.deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(set.timelimit));
+
+    // Live metrics, written until the solve ends.
+    std::unique_ptr<fgmetrics> monitor;
+    if (set.metrics > 0 && set.metricsfile != "-") {
+        monitor.reset(new fgmetrics(set.metricsfile, set.metrics, set.master, set.run, set.target, set.flimit, set.nomuls));
+        set.monitor = monitor.get();
+    }
+    fgwalk walk(muls, set.flips, set.target, set.flimit, set.plimit, set.termination, set.rseed, set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+    setoptions(walk, set);
+
+    // Shared pool slots have room for the naive scheme, n cubed products for n x n matrices.
+    fgshared shared;
+    fgshared* sp = NULL;
+    if (set.shared != "-") {
+        vlong bits = 0;
+        for (vlong m : muls) {
+            bits |= m;
+        }
+        int n = 1;
+        while (n * n < 64 && (bits >> (n * n)) != 0) {
+            n++;
+        }
+        int slotmuls = 3 * n * n * n + set.symm;
+        if (shared.open(set.shared, walk.fingerprint, set.symm, slotmuls - slotmuls % set.symm, 64)) {
+            sp = &shared;
+        }
+        else {
+            std::cerr << "Could not open shared scheme pool " << set.shared << ", continuing without it.\n";
+        }
+    }
+
+    // Hold point, a first walk runs to the hold rank and the forks all continue from the scheme it reached,
+    // as walkers or replicas with streams of their own, so the early descent is only done once.
+    std::vector<vlong> from = muls;
+    fgresult held;
+    bool halted = false;
+    if (set.hold > set.target && set.forks > 0) {
+        fgwalk first(muls, set.flips, set.hold, set.flimit, set.plimit, set.termination, set.rseed, set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+        setoptions(first, set);
+        first.shared = sp;
+        first.run();
+        vlong h;
+        std::vector<vlong>& out = first.result(h);
+        held.muls = out;
+        held.rank = first.minmuls;
+        held.rcode = first.rcode;
+        held.hash = h;
+        held.flips = first.flips;
+        held.plus = first.plus;
+        held.reductions = first.reductions;
+        held.greedyflips = first.greedyflips;
+        if (first.rcode == 5 || first.minmuls > set.hold) {
+            halted = true;
+        }
+        else {
+            from = out;
+            set.walkers = set.forks;
+            set.stage = 1;
+        }
+    }
+
+    fgresult out;
+    if (halted) {
+        out = held;
+        out.achieved = held.rank;
+    }
+    else if (set.walkers <= 1 && set.restarts == 0 && set.replicas <= 1 && set.branches <= 1 && set.stage == 0) {
+        walk.shared = sp;
+        walk.dumpfile = dump;
+        fgrecorder recorder;
+        if (set.record != "-") {
+            std::ostringstream text;
+            writeinput(text, set, muls);
+            if (recorder.open(set.record, text.str())) {
+                walk.setrecorder(&recorder);
+            }
+            else {
+                std::cerr << "Could not open flight record " << set.record << ", continuing without it.\n";
+            }
+        }
+        walk.run();
+        out.muls = walk.result(out.hash);
+        out.rank = walk.minmuls;
+        out.achieved = walk.achieved;
+        out.rcode = walk.rcode;
+        out.flips = walk.flips;
+        out.plus = walk.plus;
+        out.reductions = walk.reductions;
+        out.greedyflips = walk.greedyflips;
+        out.swaps = walk.swaps;
+        out.branches = walk.branches;
+        out.reach = walk.reach;
+    }
+    else {
+        std::vector<fgresult> results;
+        if (set.replicas > 1) {
+            results.resize(1);
+            temper(set, from, sp, results[0]);
+        }
+        else if (set.branches > 1) {
+            results.resize(1);
+            branch(set, from, sp, results[0]);
+        }
+        else {
+            if (set.walkers < 1) {
+                set.walkers = 1;
+            }
+            fgpool pool(4 * set.walkers);
+            std::atomic<int> stop(0);
+            results.resize(set.walkers);
+            std::vector<std::thread> threads;
+            for (int k = 0; k < set.walkers; k++) {
+                threads.push_back(std::thread(walker, k, std::ref(set), std::ref(from), std::ref(pool), sp, std::ref(stop), std::ref(results[k])));
+            }
+            for (std::thread& t : threads) {
+                t.join();
+            }
+        }
+        int b = 0;
+        bool diverged = false;
+        for (int k = 0; k < (int)results.size(); k++) {
+            fgresult& res = results[k];
+            held.flips += res.flips;
+            held.plus += res.plus;
+            held.reductions += res.reductions;
+            held.greedyflips += res.greedyflips;
+            held.swaps += res.swaps;
+            held.branches += res.branches;
+            if (res.rcode == 5) {
+                diverged = true;
+            }
+            if (res.rank < results[b].rank) {
+                b = k;
+            }
+        }
+        out = results[b];
+        out.achieved = out.rank;
+        out.rcode = diverged ? 5 : out.rcode;
+        out.flips = held.flips;
+        out.plus = held.plus;
+        out.reductions = held.reductions;
+        out.greedyflips = held.greedyflips;
+        out.swaps = held.swaps;
+        out.branches = held.branches;
+        out.reach.clear();
+    }
+
+    if (out.rcode == 5) {
+        std::cerr << "Tensor fingerprint changed after " << out.flips << " flips, returning starting scheme.\n";
+        out.achieved = 0;
+        for (vlong m : muls) {
+            if (m > 0) {
+                out.achieved++;
+            }
+        }
+        out.rank = out.achieved;
+        out.muls = muls;
+        out.hash = 0;
+    }
+    return out;
+}
+
+// Solve from input text in the interface file format, returning the outcome as text in the same format, to be
+// released with fgfree.  Each call has its own state, so solves may run at once on several threads.  The solve
+// runs in the caller's process, so a scheme with no flips at all returns rcode -1 from the walk's start rather
+// than reaching its sampling.
+FGEXPORT char* fgsolve(const char* input) {
+    std::istringstream input_stream(input);
+    fgsettings set;
+    std::vector<vlong> muls;
+    readinput(input_stream, set, muls);
+    fgresult res = solve(set, muls, "", false);
+    std::ostringstream output;
+    writeresult(output, set, res);
+    std::string s = output.str();
+    char* p = (char*)std::malloc(s.size() + 1);
+    std::memcpy(p, s.c_str(), s.size() + 1);
+    return p;
+}
+
+// Release text returned by fgsolve.
+FGEXPORT void fgfree(char* p) {
+    std::free(p);
+}
+
+// Replay the flight record in file lname, checking the walk against it event by event, then report the flips
+// spent at each rank, the reductions from each and the products they removed.  With upto the replay stops after
+// that many flips and writes the scheme there in the interface file format instead.  Returns non-zero if the
+// record could not be read or the walk does not match it.
+int replay(const char* lname, vlong upto) {
+    std::ifstream f(lname, std::ios::binary);
+    std::string s((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+    size_t i = 8;
+    vlong n;
+    if (s.compare(0, 8, "FGFLIGHT") != 0 || !fgrecorder::readvarint(s, i, n) || i + n > s.size()) {
+        std::cerr << "Not a flight record: " << lname << "\n";
+        return 1;
+    }
+    std::istringstream text(s.substr(i, n));
+    std::string events = s.substr(i + n);
+    fgsettings set;
+    std::vector<vlong> muls;
+    readinput(text, set, muls);
+
+    // Events of the log, the walk replayed to the last, or to its end if it has one.
+    std::vector<vlong> eflips;
+    std::vector<int> kinds;
+    std::vector<std::vector<vlong>> efields;
+    vlong last = 0;
+    size_t j = 0, good = 0;
+    int kind;
+    vlong fv[3];
+    while (fgrecorder::readevent(events, j, last, kind, fv)) {
+        good = j;
+        eflips.push_back(last);
+        kinds.push_back(kind);
+        efields.push_back(std::vector<vlong>(fv, fv + fgrecorder::fields[kind]));
+    }
+    bool ended = !kinds.empty() && kinds.back() == fgrecorder::end;
+    last = eflips.empty() ? set.flips : eflips.back();
+    vlong stop = upto > 0 ? upto : last;
+
+    fgwalk walk(muls, set.flips, set.target, set.flimit, set.plimit, set.termination, set.rseed, set.symm, set.maxplus, set.split, set.maxsize, set.greedy, set.hugepages);
+    setoptions(walk, set);
+    int start = walk.achieved;
+    fgrecorder check;
+    check.check(events.substr(0, good));
+    walk.setrecorder(&check);
+    bool finished = walk.start() != 0;
+    while (!check.diverged && !finished && walk.flips < stop) {
+        finished = walk.symm == 3 ? walk.step3() : walk.step6();
+    }
+    if (upto > 0) {
+        walk.fullhash();
+        walk.write(std::cout, 2, walk.muls, walk.hash);
+        return check.diverged;
+    }
+    if (ended && !check.diverged) {
+        if (!finished) {
+            walk.rcode = (int)efields.back()[0] - 1;
+        }
+        vlong h;
+        walk.result(h);
+    }
+    if (!check.diverged && check.at < good) {
+        check.diverged = true;
+    }
+
+    // Flips at each rank and reductions from it, and reductions by product, from the events.
+    std::map<int, vlong> atrank, fromrank;
+    std::map<int, int> byproduct;
+    int rank = start;
+    vlong since = set.flips;
+    for (size_t k = 0; k < kinds.size(); k++) {
+        int r = rank;
+        if (kinds[k] == fgrecorder::plusevent) {
+            r = rank + set.symm;
+        }
+        else if (kinds[k] == fgrecorder::reduction) {
+            r = (int)efields[k][1];
+            fromrank[rank]++;
+            byproduct[(int)efields[k][0] / 3]++;
+        }
+        else if (kinds[k] == fgrecorder::undo || kinds[k] == fgrecorder::checkpoint) {
+            r = (int)efields[k][0];
+        }
+        if (r != rank || kinds[k] == fgrecorder::end) {
+            atrank[rank] += eflips[k] - since;
+            since = eflips[k];
+            rank = r;
+        }
+    }
+    std::cout << "Flight record " << lname << " - Seed: " << set.rseed << " Run: " << set.run << " Start: " << start << " Target: " << set.target << " Flips: " << last;
+    if (ended) {
+        std::cout << " Best: " << efields.back()[1] << " Code: " << (long long)efields.back()[0] - 1;
+    }
+    else {
+        std::cout << " (no end, cut short)";
+    }
+    std::cout << "\n";
+    for (auto it = atrank.rbegin(); it != atrank.rend(); ++it) {
+        std::cout << "Rank: " << it->first << " Flips: " << it->second << " Reductions: " << fromrank[it->first] << "\n";
+    }
+    std::cout << "Reductions by product:";
+    for (auto& x : byproduct) {
+        std::cout << " " << x.first << "/" << x.second;
+    }
+    std::cout << "\n";
+    if (check.diverged) {
+        std::cout << "Replay diverged from the record by " << walk.flips << " flips.\n";
+        return 1;
+    }
+    std::cout << "Replay matches the record, " << kinds.size() << " events.\n";
+    return 0;
+}
+
+// Cancel solves running in the library, which end with their best scheme so far as on SIGTERM to the solver
+// program, and any started until it is called again with 0.
+FGEXPORT void fgcancel(int on) {
+    fgstopping.store(on, std::memory_order_relaxed);
+}
+
+// BLAKE2b with an 8 byte digest, as hashlib.blake2b(data, digest_size=8) in Python, the digest read as a
+// little-endian number.  Used for the scheme hashes of the results store.
+vlong blake2b64(const std::string& data) {
+    static const vlong iv[8] = {
+        0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+        0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL };
+    static const unsigned char sigma[10][16] = {
+        { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 },
+        { 14, 10, 4, 8, 9, 15, 13, 6, 1, 12, 0, 2, 11, 7, 5, 3 },
+        { 11, 8, 12, 0, 5, 2, 15, 13, 10, 14, 3, 6, 7, 1, 9, 4 },
+        { 7, 9, 3, 1, 13, 12, 11, 14, 2, 6, 5, 10, 4, 0, 15, 8 },
+        { 9, 0, 5, 7, 2, 4, 10, 15, 14, 1, 11, 12, 6, 8, 3, 13 },
+        { 2, 12, 6, 10, 0, 11, 8, 3, 4, 13, 7, 5, 15, 14, 1, 9 },
+        { 12, 5, 1, 15, 14, 13, 4, 10, 0, 7, 6, 3, 9, 2, 8, 11 },
+        { 13, 11, 7, 14, 12, 1, 3, 9, 5, 0, 15, 4, 8, 6, 2, 10 },
+        { 6, 15, 14, 9, 11, 3, 0, 8, 12, 2, 13, 7, 1, 4, 10, 5 },
+        { 10, 2, 8, 4, 7, 6, 1, 5, 15, 11, 9, 14, 3, 12, 13, 0 } };
+    static const int lanes[8][4] = {
+        { 0, 4, 8, 12 }, { 1, 5, 9, 13 }, { 2, 6, 10, 14 }, { 3, 7, 11, 15 },
+        { 0, 5, 10, 15 }, { 1, 6, 11, 12 }, { 2, 7, 8, 13 }, { 3, 4, 9, 14 } };
+    vlong h[8];
+    for (int i = 0; i < 8; i++) {
+        h[i] = iv[i];
+    }
+    h[0] ^= 0x01010008ULL;
+    size_t done = 0;
+    vlong t = 0;
+    bool last = false;
+    while (!last) {
+        size_t take = data.size() - done;
+        last = take <= 128;
+        if (!last) {
+            take = 128;
+        }
+        unsigned char block[128] = { 0 };
+        std::memcpy(block, data.data() + done, take);
+        done += take;
+        t += take;
+        vlong m[16], v[16];
+        for (int i = 0; i < 16; i++) {
+            m[i] = 0;
+            for (int j = 7; j >= 0; j--) {
+                m[i] = m[i] << 8 | block[8 * i + j];
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            v[i] = h[i];
+            v[i + 8] = iv[i];
+        }
+        v[12] ^= t;
+        if (last) {
+            v[14] = ~v[14];
+        }
+        for (int r = 0; r < 12; r++) {
+            const unsigned char* s = sigma[r % 10];
+            for (int g = 0; g < 8; g++) {
+                vlong& a = v[lanes[g][0]];
+                vlong& b = v[lanes[g][1]];
+                vlong& c = v[lanes[g][2]];
+                vlong& d = v[lanes[g][3]];
+                a += b + m[s[2 * g]];
+                d = (d ^ a) >> 32 | (d ^ a) << 32;
+                c += d;
+                b = (b ^ c) >> 24 | (b ^ c) << 40;
+                a += b + m[s[2 * g + 1]];
+                d = (d ^ a) >> 16 | (d ^ a) << 48;
+                c += d;
+                b = (b ^ c) >> 63 | (b ^ c) << 1;
+            }
+        }
+        for (int i = 0; i < 8; i++) {
+            h[i] ^= v[i] ^ v[i + 8];
+        }
+    }
+    return h[0];
+}
+
+// Returns non-zero if a file exists.
+int fileexists(const std::string& fname) {
+    FILE* f = std::fopen(fname.c_str(), "rb");
+    if (f != NULL) {
+        std::fclose(f);
+    }
+    return f != NULL;
+}
+
+// Scheme store of a results folder, schemes.bin and schemes.idx in the format written by SchemeStore in
+// MatrixMult22.py, so campaigns run there and here add to and start from the same store.  Entries are 32 bytes,
+// matrix size, flags, rank, 4 bytes padding, name number, offset in schemes.bin and a hash of the multiplications
+// independent of their order, all little-endian.  An entry saved under the name of an earlier one replaces it.
+class fgstore {
+public:
+    struct entry {
+        int size, flags, rank;
+        vlong rf, off, hash;
+    };
+
+    int n;
+    std::string folder, bname, iname;
+    std::vector<entry> ents;
+    std::map<std::pair<int, int>, std::vector<int>> live;      // (size, rank) and (size, -1) to entries not replaced.
+    std::map<std::tuple<int, int, int>, int> pos;               // (size, rank, entry) to its place in the live list.
+    std::map<std::tuple<int, int, vlong>, int> names;           // (size, rank, name number) to latest entry.
+    std::set<std::pair<int, vlong>> hashes;                     // (size, hash) of entries not replaced.
+    std::mt19937_64 rng;
+
+    // Constructor, for n x n matrices, importing any text scheme files in the folder the first time.
+    fgstore(int dim, const std::string& dir, vlong seed, int verbose) : rng(seed) {
+        n = dim;
+        folder = dir;
+        bname = folder + "/schemes.bin";
+        iname = folder + "/schemes.idx";
+        if (!fileexists(iname)) {
+            importtext(verbose);
+        }
+        refresh();
+    }
+
+    // Hash of the multiplications, three masks each, independent of their order, as SchemeStore.digest.
+    static vlong digest(const std::vector<vlong>& m) {
+        std::vector<std::tuple<vlong, vlong, vlong>> t;
+        for (size_t i = 0; i + 2 < m.size(); i += 3) {
+            t.push_back(std::make_tuple(m[i], m[i + 1], m[i + 2]));
+        }
+        std::sort(t.begin(), t.end());
+        std::string s = "[";
+        for (size_t i = 0; i < t.size(); i++) {
+            s += i > 0 ? ", [" : "[";
+            s += std::to_string(std::get<0>(t[i])) + ", " + std::to_string(std::get<1>(t[i])) + ", " + std::to_string(std::get<2>(t[i])) + "]";
+        }
+        s += "]";
+        return blake2b64(s);
+    }
+
+    // Add entry e to the live lists.
+    void link(int e) {
+        entry& x = ents[e];
+        std::pair<int, int> keys[2] = { { x.size, x.rank }, { x.size, -1 } };
+        for (auto& k : keys) {
+            std::vector<int>& l = live[k];
+            pos[std::make_tuple(k.first, k.second, e)] = (int)l.size();
+            l.push_back(e);
+        }
+        hashes.insert(std::make_pair(x.size, x.hash));
+    }
+
+    // Remove entry e from the live lists, moving the last entry of each into its place.
+    void unlink(int e) {
+        entry& x = ents[e];
+        std::pair<int, int> keys[2] = { { x.size, x.rank }, { x.size, -1 } };
+        for (auto& k : keys) {
+            std::vector<int>& l = live[k];
+            auto p = pos.find(std::make_tuple(k.first, k.second, e));
+            int i = p->second;
+            pos.erase(p);
+            int last = l.back();
+            l.pop_back();
+            if (last != e) {
+                l[i] = last;
+                pos[std::make_tuple(k.first, k.second, last)] = i;
+            }
+        }
+        hashes.erase(std::make_pair(x.size, x.hash));
+    }
+
+    // Read index entries added since the last call, by this or another process.
+    void refresh() {
+        std::ifstream f(iname, std::ios::binary);
+        if (!f) {
+            return;
+        }
+        f.seekg(32 * (std::streamoff)ents.size());
+        unsigned char b[32];
+        while (f.read((char*)b, 32)) {
+            entry x;
+            x.size = b[0];
+            x.flags = b[1];
+            x.rank = b[2] | b[3] << 8;
+            x.rf = x.off = x.hash = 0;
+            for (int j = 7; j >= 0; j--) {
+                x.rf = x.rf << 8 | b[8 + j];
+                x.off = x.off << 8 | b[16 + j];
+                x.hash = x.hash << 8 | b[24 + j];
+            }
+            int e = (int)ents.size();
+            ents.push_back(x);
+            auto key = std::make_tuple(x.size, x.rank, x.rf);
+            auto old = names.find(key);
+            if (old != names.end() && (ents[old->second].flags & 1) == 0) {
+                ents[old->second].flags |= 1;
+                unlink(old->second);
+            }
+            names[key] = e;
+            if ((x.flags & 1) == 0) {
+                link(e);
+            }
+        }
+    }
+
+    // Name of entry e.
+    std::string name(int e) {
+        std::string r = std::to_string(ents[e].rank);
+        std::string f = std::to_string(ents[e].rf);
+        return "m" + std::string(r.size() < 3 ? 3 - r.size() : 0, '0') + r + "r" + std::string(f.size() < 10 ? 10 - f.size() : 0, '0') + f;
+    }
+
+    // Latest entry saved under a name (a trailing .txt is ignored), or -1.
+    int find(std::string s) {
+        refresh();
+        if (s.size() > 4 && s.compare(s.size() - 4, 4, ".txt") == 0) {
+            s.resize(s.size() - 4);
+        }
+        if (s.size() < 6 || s.find_first_not_of("0123456789", 1) != 4 || s.find_first_not_of("0123456789", 5) != std::string::npos) {
+            return -1;
+        }
+        auto p = names.find(std::make_tuple(n, std::atoi(s.substr(1, 3).c_str()), (vlong)std::stoull(s.substr(5))));
+        return p == names.end() ? -1 : p->second;
+    }
+
+    // Random entry of the given rank, or of any rank if rank is -1, or -1 if there is none.
+    int choose(int rank) {
+        refresh();
+        std::vector<int>& l = live[std::make_pair(n, rank)];
+        if (l.empty()) {
+            return -1;
+        }
+        return l[rng() % l.size()];
+    }
+
+    // Multiplications of entry e, three masks each.
+    std::vector<vlong> muls(int e) {
+        std::vector<vlong> m(3 * ents[e].rank);
+        std::ifstream f(bname, std::ios::binary);
+        f.seekg((std::streamoff)ents[e].off);
+        std::vector<unsigned char> b(8 * m.size());
+        f.read((char*)b.data(), b.size());
+        for (size_t i = 0; i < m.size(); i++) {
+            m[i] = 0;
+            for (int j = 7; j >= 0; j--) {
+                m[i] = m[i] << 8 | b[8 * i + j];
+            }
+        }
+        return m;
+    }
+
+    // Append a scheme, under name if given, replacing the scheme saved under it, or else under a new random name.
+    // Returns the name, or an empty string if the same scheme is already in the store.
+    std::string add(const std::vector<vlong>& m, int rank, std::string s = "") {
+        refresh();
+        vlong h = digest(m);
+        if (hashes.count(std::make_pair(n, h)) > 0) {
+            return "";
+        }
+#ifdef _WIN32
+        _mkdir(folder.c_str());
+#else
+        mkdir(folder.c_str(), 0777);
+#endif
+        FILE* fi = std::fopen(iname.c_str(), "ab");
+        if (fi == NULL) {
+            std::cerr << "Cannot write " << iname << ".\n";
+            return "";
+        }
+#ifndef _WIN32
+        flock(fileno(fi), LOCK_EX);
+#endif
+        refresh();
+        FILE* fb = NULL;
+        if (hashes.count(std::make_pair(n, h)) == 0) {
+            fb = std::fopen(bname.c_str(), "ab");
+            if (fb == NULL) {
+                std::cerr << "Cannot write " << bname << ".\n";
+            }
+        }
+        if (fb == NULL) {
+#ifndef _WIN32
+            flock(fileno(fi), LOCK_UN);
+#endif
+            std::fclose(fi);
+            return "";
+        }
+        vlong rf;
+        if (!s.empty()) {
+            rf = std::stoull(s.substr(5, 10));
+        }
+        else {
+            rf = rng() % 10000000000ULL;
+            while (names.count(std::make_tuple(n, rank, rf)) > 0) {
+                rf++;
+            }
+        }
+        std::fseek(fb, 0, SEEK_END);
+        vlong off = (vlong)std::ftell(fb);
+        std::vector<unsigned char> b(8 * m.size());
+        for (size_t i = 0; i < m.size(); i++) {
+            for (int j = 0; j < 8; j++) {
+                b[8 * i + j] = (unsigned char)(m[i] >> 8 * j);
+            }
+        }
+        std::fwrite(b.data(), 1, b.size(), fb);
+        std::fclose(fb);
+        unsigned char x[32] = { (unsigned char)n, 0, (unsigned char)rank, (unsigned char)(rank >> 8) };
+        for (int j = 0; j < 8; j++) {
+            x[8 + j] = (unsigned char)(rf >> 8 * j);
+            x[16 + j] = (unsigned char)(off >> 8 * j);
+            x[24 + j] = (unsigned char)(h >> 8 * j);
+        }
+        std::fwrite(x, 1, 32, fi);
+        std::fflush(fi);
+        auto old = names.find(std::make_tuple(n, rank, rf));
+        if (old != names.end()) {
+            FILE* fr = std::fopen(iname.c_str(), "r+b");
+            if (fr != NULL) {
+                std::fseek(fr, 32 * (long)old->second + 1, SEEK_SET);
+                std::fputc(ents[old->second].flags | 1, fr);
+                std::fclose(fr);
+            }
+        }
+#ifndef _WIN32
+        flock(fileno(fi), LOCK_UN);
+#endif
+        std::fclose(fi);
+        refresh();
+        std::string r = std::to_string(rank);
+        std::string f = std::to_string(rf);
+        return "m" + std::string(r.size() < 3 ? 3 - r.size() : 0, '0') + r + "r" + std::string(f.size() < 10 ? 10 - f.size() : 0, '0') + f;
+    }
+
+    // Add the text scheme files in the folder, m*.txt with a name number, keeping their names.
+    void importtext(int verbose) {
+        std::vector<std::string> tnames;
+#ifndef _WIN32
+        DIR* d = opendir(folder.c_str());
+        if (d == NULL) {
+            return;
+        }
+        while (struct dirent* de = readdir(d)) {
+            std::string s = de->d_name;
+            if (s.size() > 9 && s[0] == 'm' && s.compare(s.size() - 4, 4, ".txt") == 0 && s.find_first_not_of("0123456789", 5) == s.size() - 4) {
+                tnames.push_back(s);
+            }
+        }
+        closedir(d);
+#endif
+        if (tnames.empty()) {
+            return;
+        }
+        std::sort(tnames.begin(), tnames.end());
+        fgformat format(n, 1, 1);
+        int count = 0;
+        for (std::string& s : tnames) {
+            std::ifstream f(folder + "/" + s, std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+            std::vector<vlong> m;
+            int err = 0;
+            int k = format.parse(text.data(), text.data() + text.size(), m, NULL, err);
+            if (k > 0 && !add(m, k, s).empty()) {
+                count++;
+            }
+        }
+        if (verbose) {
+            std::cout << "Imported " << count << " text schemes into " << iname << "\n";
+        }
+    }
+};
+
+// Python str() of a float, the shortest text reading back as the same number.
+std::string pyfloat(double x) {
+    char s[32];
+    for (int p = 1; p <= 17; p++) {
+        snprintf(s, sizeof(s), "%.*g", p, x);
+        if (std::strtod(s, NULL) == x) {
+            break;
+        }
+    }
+    std::string r = s;
+    if (r.find_first_of(".en") == std::string::npos) {
+        r += ".0";
+    }
+    return r;
+}
+
+// Number left padded with zeros to width w.
+std::string zfill(long long x, int w) {
+    std::string s = std::to_string(x);
+    return std::string(s.size() < (size_t)w ? w - s.size() : 0, '0') + s;
+}
+
+// File name with "-" and tag added before its extension, as with os.path.splitext in Python.
+std::string suffixed(const std::string& name, const std::string& tag) {
+    size_t dot = name.rfind('.');
+    size_t sep = name.find_last_of("/\\");
+    size_t base = sep == std::string::npos ? 0 : sep + 1;
+    while (base < name.size() && name[base] == '.') {
+        base++;
+    }
+    if (dot == std::string::npos || dot < base) {
+        dot = name.size();
+    }
+    return name.substr(0, dot) + "-" + tag + name.substr(dot);
+}
+
+// A scheme to verify or lift, its multiplications read from a text file or taken from a store.
+struct fgscheme {
+    std::string name;
+    std::vector<vlong> masks;
+    int stored;
+};
+
+// Returns non-zero if a file name is that of a scheme, m<rank>r<digits>.txt as in a results folder or <sizes>m<rank>.txt
+// as in the schemes folder, with _lifted before .txt only if lifted is set, so history and rates files are passed over.
+int schemefile(std::string s, int lifted) {
+    const char* digits = "0123456789";
+    if (s.size() < 5 || s.compare(s.size() - 4, 4, ".txt") != 0) {
+        return 0;
+    }
+    s.erase(s.size() - 4);
+    if (s.size() > 7 && s.compare(s.size() - 7, 7, "_lifted") == 0) {
+        if (!lifted) {
+            return 0;
+        }
+        s.erase(s.size() - 7);
+    }
+    size_t m = s.find('m');
+    if (m == std::string::npos || s.find_first_not_of(digits) != m || m + 1 == s.size()) {
+        return 0;
+    }
+    size_t r = s.find_first_not_of(digits, m + 1);
+    if (r == std::string::npos) {
+        return 1;
+    }
+    return m == 0 && r > 1 && s[r] == 'r' && r + 1 < s.size() && s.find_first_not_of(digits, r + 1) == std::string::npos;
+}
+
+// Add the schemes of a path, a scheme file, the scheme files of a folder, lifted ones only if lifted is set,
+// and the schemes of its store, or a scheme in a store named by folder and name, e.g. results/m093r0123456789.
+void listschemes(int n, const std::string& path, int lifted, std::vector<fgscheme>& out) {
+    std::set<std::string> seen;
+    int folder = 0;
+#ifndef _WIN32
+    DIR* d = opendir(path.c_str());
+    if (d != NULL) {
+        std::vector<std::string> tnames;
+        while (struct dirent* de = readdir(d)) {
+            std::string s = de->d_name;
+            if (schemefile(s, lifted)) {
+                tnames.push_back(s);
+            }
+        }
+        closedir(d);
+        std::sort(tnames.begin(), tnames.end());
+        for (const std::string& s : tnames) {
+            out.push_back({ path + "/" + s, {}, 0 });
+            seen.insert(s);
+        }
+        folder = 1;
+    }
+#endif
+    if (fileexists(path + "/schemes.idx")) {
+        fgstore store(n, path, 0, 0);
+        for (int e : store.live[std::make_pair(n, -1)]) {
+            if (seen.count(store.name(e) + ".txt") == 0) {
+                out.push_back({ path + "/" + store.name(e), store.muls(e), 1 });
+            }
+        }
+        return;
+    }
+    size_t sep = path.find_last_of("/\\");
+    std::string dir = sep == std::string::npos ? "." : path.substr(0, sep);
+    if (!folder && !fileexists(path) && fileexists(dir + "/schemes.idx")) {
+        fgstore store(n, dir, 0, 0);
+        int e = store.find(path.substr(sep + 1));
+        if (e >= 0) {
+            out.push_back({ path, store.muls(e), 1 });
+            return;
+        }
+    }
+    if (!folder) {
+        out.push_back({ path, {}, 0 });
+    }
+}
+
+// Read the multiplications of a scheme from its file, if not taken from a store.  Returns an error message, or an
+// empty string if it was read.
+std::string readscheme(fgformat& format, fgscheme& x, std::vector<vlong>& masks) {
+    masks.clear();
+    if (x.stored) {
+        masks.swap(x.masks);
+        return "";
+    }
+    FILE* f = std::fopen(x.name.c_str(), "rb");
+    if (f == NULL) {
+        return "Cannot open.";
+    }
+    std::fseek(f, 0, SEEK_END);
+    long len = std::ftell(f);
+    std::fseek(f, 0, SEEK_SET);
+    std::vector<char> text(len > 0 ? len : 1);
+    len = (long)std::fread(text.data(), 1, len, f);
+    std::fclose(f);
+    int err = 0;
+    if (format.parse(text.data(), text.data() + len, masks, NULL, err) < 0) {
+        return "Not a scheme, line " + std::to_string(err) + ".";
+    }
+    return "";
+}
+
+// Call work(i) for i from 0 to count - 1 in parallel, each thread taking the next i.
+template <typename F>
+void parallelfor(size_t count, F work) {
+    std::atomic<size_t> next(0);
+    auto run = [&]() {
+        size_t i;
+        while ((i = next++) < count) {
+            work(i);
+        }
+    };
+    int nthreads = (int)std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), std::max<size_t>(count, 1));
+    std::vector<std::thread> threads;
+    for (int k = 1; k < nthreads; k++) {
+        threads.emplace_back(run);
+    }
+    run();
+    for (std::thread& th : threads) {
+        th.join();
+    }
+}
+
+// Verify schemes over GF(2), the Brent equations of n x n matrix multiplication, for MatrixMult22.py and by hand.
+//   --verify n order trans path ...  checks each scheme file, and in each folder its text scheme files and the
+//                                    schemes of its store, all in parallel.  Prints a line for each scheme, with its
+//                                    residual drawn as by matstr and its first terms if it has errors, then a count.
+// The tensor of each multiplication is XORed in bit sliced, the A mask into the word of each pair of set bits of the
+// B and C masks.  Returns 0 if all schemes are correct, 2 if any has errors and 1 if any cannot be read.
+int verifyschemes(int argc, char* argv[]) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " --verify n order trans path ...\n";
+        return 1;
+    }
+    fgformat format(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
+    if (format.n < 1 || format.n > 8) {
+        std::cerr << "Matrix size must be 1 to 8.\n";
+        return 1;
+    }
+    std::vector<vlong> answ;
+    format.answer(answ);
+    std::vector<fgscheme> jobs;
+    for (int i = 5; i < argc; i++) {
+        listschemes(format.n, argv[i], 1, jobs);
+    }
+
+    // Check them in parallel and print the outcomes in order.
+    std::vector<std::string> outs(jobs.size());
+    std::vector<int> codes(jobs.size(), 0);
+    parallelfor(jobs.size(), [&](size_t i) {
+        std::vector<vlong> masks;
+        std::string msg = readscheme(format, jobs[i], masks);
+        if (!msg.empty()) {
+            outs[i] = jobs[i].name + " " + msg + "\n";
+            codes[i] = 1;
+            return;
+        }
+        std::vector<vlong> t = answ;
+        for (size_t k = 0; k + 2 < masks.size(); k += 3) {
+            format.toggle(t, masks[k], masks[k + 1], masks[k + 2]);
+        }
+        int err = 0;
+        for (vlong w : t) {
+            err += bitcount(w);
+        }
+        outs[i] = jobs[i].name + " Muls: " + std::to_string(masks.size() / 3) + " Error: " + std::to_string(err) + "\n";
+        if (err > 0) {
+            outs[i] += tensorstr(t, format.n) + "Residual: " + format.terms(t, 16) + "\n";
+            codes[i] = 2;
+        }
+    });
+    int rc = 0, bad = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::fwrite(outs[i].data(), 1, outs[i].size(), stdout);
+        bad += codes[i] != 0;
+        rc = codes[i] == 1 || rc == 1 ? 1 : std::max(rc, codes[i]);
+    }
+    std::cout << "Verified " << jobs.size() << " schemes, " << bad << " with errors.\n";
+    return rc;
+}
+
+// Lift a scheme to integer coefficients, trying the unknowns in up to tries orders, and write it in the signed form
+// to its name with _lifted added, the lifted files in the schemes folder being made this way.  Returns the outcome as
+// printed by --lift.
+std::string liftscheme(fgformat& format, const std::string& name, const std::vector<vlong>& masks, int tries) {
+    std::string s = name + " Muls: " + std::to_string(masks.size() / 3);
+    int most = 16, steps = -1;
+    for (int t = 0; t < tries; t++) {
+        fglift lifter(format, masks, t);
+        int r = lifter.lift(most);
+        if (r < 0) {
+            return s + " Not a scheme over GF(2).";
+        }
+        if (r == 0) {
+            steps = std::max(steps, lifter.steps);
+            continue;
+        }
+        std::string lname = name;
+        if (lname.size() > 4 && lname.compare(lname.size() - 4, 4, ".txt") == 0) {
+            lname.resize(lname.size() - 4);
+        }
+        lname += "_lifted.txt";
+        std::string out;
+        std::vector<int> c(3 * format.size);
+        int large = 0;
+        for (size_t k = 0; k < masks.size() / 3; k++) {
+            for (int j = 0; j < 3 * format.size; j++) {
+                c[j] = (int)lifter.coeffs[3 * format.size * k + j];
+                large = std::max(large, std::abs(c[j]));
+            }
+            format.write(out, masks.data() + 3 * k, c.data());
+        }
+        FILE* f = std::fopen(lname.c_str(), "wb");
+        if (f == NULL) {
+            return s + " Cannot write " + lname + ".";
+        }
+        std::fwrite(out.data(), 1, out.size(), f);
+        std::fclose(f);
+        return s + " Lifted: " + lname + " Steps: " + std::to_string(lifter.steps) + " Largest: " + std::to_string(large) + " Tries: " + std::to_string(t + 1);
+    }
+    if (steps == most) {
+        return s + " Lifts mod 2^" + std::to_string(most + 1) + ", not over the integers.";
+    }
+    return s + (steps > 0 ? " Lifts only mod 2^" + std::to_string(steps + 1) + "." : " No lift mod 4.");
+}
+
+// Lift schemes over GF(2) to integer coefficients, for MatrixMult22.py and by hand.
+//   --lift n order trans path ...  lifts each scheme file, and in each folder its text scheme files but lifted ones
+//                                  and the schemes of its store, all in parallel, writing each that lifts to its name
+//                                  with _lifted added, e.g. 555m93_lifted.txt.  Prints a line for each, then a count.
+// A scheme that does not lift is tried again with its unknowns in up to 7 other orders.
+// Returns 0 if all schemes lift, 2 if any does not and 1 if any cannot be read.
+int liftschemes(int argc, char* argv[]) {
+    if (argc < 6) {
+        std::cerr << "Usage: " << argv[0] << " --lift n order trans path ...\n";
+        return 1;
+    }
+    fgformat format(std::atoi(argv[2]), std::atoi(argv[3]), std::atoi(argv[4]));
+    if (format.n < 1 || format.n > 8) {
+        std::cerr << "Matrix size must be 1 to 8.\n";
+        return 1;
+    }
+    std::vector<fgscheme> jobs;
+    for (int i = 5; i < argc; i++) {
+        listschemes(format.n, argv[i], 0, jobs);
+    }
+    std::vector<std::string> outs(jobs.size());
+    std::vector<int> codes(jobs.size(), 0);
+    parallelfor(jobs.size(), [&](size_t i) {
+        std::vector<vlong> masks;
+        std::string msg = readscheme(format, jobs[i], masks);
+        if (!msg.empty()) {
+            outs[i] = jobs[i].name + " " + msg;
+            codes[i] = 1;
+            return;
+        }
+        outs[i] = liftscheme(format, jobs[i].name, masks, 8);
+        codes[i] = outs[i].find(" Lifted: ") == std::string::npos ? 2 : 0;
+    });
+    int rc = 0, lifted = 0;
+    for (size_t i = 0; i < jobs.size(); i++) {
+        std::cout << outs[i] << "\n";
+        lifted += codes[i] == 0;
+        rc = codes[i] == 1 || rc == 1 ? 1 : std::max(rc, codes[i]);
+    }
+    std::cout << "Lifted " << lifted << " of " << jobs.size() << " schemes.\n";
+    return rc;
+}
+
+// Campaign run natively from an input file in the format read by inputfile in MatrixMult22.py, the same keywords,
+// start schemes, console output, runlog.txt, results store, history and rate model files, without Python.  Solves
+// always take their seeds from the random seed and run number, as with SEED_STREAMS: SOLVER there, so a seeded
+// campaign gives the same results as MatrixMult22.py run with that setting.  ARM: lines are not supported.
+class fgcampaign {
+public:
+    // Input file settings, named after the controls in MatrixMult22.py.
+    int matdim = 0, rt = 0, target = 0, symm = 3, save = 0, start = 0, solves = 1, concurrent = 0;
+    int print = 1, style = 0, writelog = 1, arms = 0;
+    long long rseed = -1;
+    std::string fname;
+    std::vector<std::string> diagc, fullc;
+    int hasdiag = 0, hasfull = 0;
+    int termination = 0, split = 0, plusrandom = 0, pluslimit = 0, maxsize = 0, lift = 0;
+    vlong flimit = 3000000, plusafter = 6000;
+    double predict = -1;
+    fgsettings opts;
+
+    // Campaign state, guarded by lock while several solves run at once, run being the solve holding it.
+    int matsize = 0, taken = 0, run = 0, inflight = 1;
+    std::vector<vlong> answ;
+    std::vector<int> summary = std::vector<int>(1000, 0);
+    std::set<std::pair<vlong, std::vector<vlong>>> savedhashes;
+    std::vector<vlong> cubes, pattern;
+    int psymm = 3;
+    fgstore* store = NULL;
+    std::mutex lock;
+
+    // Destructor.
+    ~fgcampaign() {
+        delete store;
+    }
+
+    // Set controls from an input file line split into words, returns the flag of a required keyword, or -1 if the
+    // keyword has been withdrawn.
+    int keyword(std::vector<std::string>& a) {
+        const std::string& k = a[0];
+        std::string v = a.size() > 1 ? a[1] : "";
+        int x = std::atoi(v.c_str());
+        int w = a.size() > 2 ? std::atoi(a[2].c_str()) : 0;
+        if (k == "MATRIX_SIZE:") { matdim = x; return 1 << 0; }
+        if (k == "FLIP_LIMIT:") { flimit = std::stoull(v); return 1 << 1; }
+        if (k == "TERMINATION_STRATEGY:") {
+            if (v == "LIMIT") { termination = 0; return 1 << 2; }
+            if (v == "EARLY") { termination = 1; return 1 << 2; }
+            if (v == "RESET") { termination = 2; return 1 << 2; }
+            if (v == "SPLIT" && a.size() > 3) { termination = w; split = std::atoi(a[3].c_str()); return 1 << 2; }
+        }
+        if (k == "PLUS_TRANSITION_AFTER:") { plusafter = std::stoull(v); return 1 << 3; }
+        if (k == "PLUS_TRANSITION_LIMIT:") { pluslimit = x; return 1 << 4; }
+        if (k == "NUMBER_OF_SOLVES:") { solves = x; return 1 << 5; }
+        if (k == "CONCURRENT_SOLVES:") { concurrent = v == "AUTO" ? 0 : x; }
+        if (k == "PRINT_OUTPUT:") {
+            const char* levels[5] = { "NONE", "SUMMARY", "STANDARD", "DETAILED", "DIAGNOSTIC" };
+            for (int i = 0; i < 5; i++) {
+                if (v == levels[i]) { print = i - 1; return 1 << 6; }
+            }
+        }
+        if (k == "SCHEME_STYLE:") {
+            if (v == "FULL") { style = 0; return 1 << 7; }
+            if (v == "SUMMARY") { style = 1; return 1 << 7; }
+        }
+        if (k == "WRITE_LOG:") {
+            if (v == "NO") { writelog = 0; return 1 << 8; }
+            if (v == "YES") { writelog = 1; return 1 << 8; }
+        }
+        if (k == "SAVE:") { save = v == "ALL" ? -1 : x; return 1 << 9; }
+        if (k == "RANDOM_SEED:") { rseed = v == "AUTO" ? -1 : std::stoll(v); return 1 << 10; }
+        if (k == "PLUS_TRANSITION_RANDOM:") {
+            if (v == "NO") { plusrandom = 0; return 1 << 11; }
+            if (v == "YES") { plusrandom = 1; return 1 << 11; }
+        }
+        if (k == "MAXIMUM_SIZE:") {
+            if (v == "NONE") { maxsize = 0; return 1 << 12; }
+            if (v == "LENGTH") { maxsize = -w; return 1 << 12; }
+            if (v == "VOLUME") { maxsize = w; return 1 << 12; }
+        }
+        if (k == "RUN_TYPE:") {
+            if (v == "NEW") { rt = 0; return 1 << 13; }
+            if (v == "CONTINUATION") { rt = 1; return 1 << 13; }
+        }
+        if (k == "TARGET:") { target = x; return 1 << 14; }
+        if (k == "SYMMETRY:") { symm = x; return 1 << 15; }
+        if (k == "SAVED_FILE:") { fname = v; }
+        if (k == "SAVED_SIZE:") { start = v == "RANDOM" ? -1 : x; }
+        if (k == "DIAGONAL_CUBES:") { diagc.assign(a.begin() + 1, a.end()); hasdiag = 1; }
+        if (k == "FULL_CUBES:") { fullc.assign(a.begin() + 1, a.end()); hasfull = 1; }
+        if (k == "ARM:") { arms++; }
+        if (k == "LOOKAHEAD:") { opts.lookahead = x; }
+        if (k == "BACKTRACK:") { opts.backtrack = std::stoull(v); }
+        if (k == "GREEDY:") { opts.greedy = x; }
+        if (k == "TABU:") { opts.tabu = x; }
+        if (k == "SENTINEL:") {
+            if (v == "CHECKPOINT") opts.sentinel = 0;
+            if (v == "CONTINUOUS") opts.sentinel = 1;
+        }
+        if (k == "WALKERS:") { opts.walkers = x; }
+        if (k == "RESTARTS:") { opts.restarts = x; }
+        if (k == "SHARED_POOL:") { opts.shared = v; }
+        if (k == "REPLICAS:") { opts.replicas = x; }
+        if (k == "SWAP_INTERVAL:") { opts.swapint = std::stoull(v); }
+        if (k == "HUGE_PAGES:") {
+            if (v == "NONE") opts.hugepages = 0;
+            if (v == "TRANSPARENT") opts.hugepages = 1;
+            if (v == "EXPLICIT") opts.hugepages = 2;
+        }
+        if (k == "CPU_AFFINITY:") { opts.affinity = v == "NONE" ? -1 : x; }
+        if (k == "HOLD_RANK:") { opts.hold = x; }
+        if (k == "FORKS:") { opts.forks = x; }
+        if (k == "BRANCH_WITHIN:") { opts.within = x; }
+        if (k == "BRANCHES:") { opts.branches = x; }
+        if (k == "PREDICTIVE_TERMINATION:") { predict = std::atof(v.c_str()); }
+        if (k == "METRICS:") {
+            opts.metrics = std::atof(v.c_str());
+            opts.metricsfile = a.size() > 2 && a[2] != "#" ? a[2] : "metrics.prom";
+        }
+        if (k == "TIME_LIMIT:") { opts.timelimit = std::atof(v.c_str()); }
+        if (k == "RECORD:") { opts.record = v == "NONE" ? "-" : v; }
+        if (k == "LIFT:") { lift = v == "ON"; }
+        if (k == "PLUS_TRANSITION_HEADROOM:" || k == "PLUS_TRANSITION_CAP:" || k == "EARLY_TERMINATION:") {
+            std::cout << "Keyword " << k << " withdrawn.\n";
+            return -1;
+        }
+        return 0;
+    }
+
+    // Threads used by one solve, the most of its walkers, replicas, forks and branches.
+    int solvecpus() {
+        return std::max(std::max(opts.walkers, opts.replicas), std::max(std::max(opts.forks, opts.branches), 1));
+    }
+
+    // Toggle the tensor of a multiplication in t, bit a of word b + matsize * c as eval in MatrixMult22.py.
+    void toggle(std::vector<vlong>& t, vlong a, vlong b, vlong c) {
+        for (vlong k = c; k; k &= k - 1) {
+            vlong* w = t.data() + matsize * lowbit(k);
+            for (vlong j = b; j; j &= j - 1) {
+                w[lowbit(j)] ^= a;
+            }
+        }
+    }
+
+    // Set the answer tensor, in the row and column order 1 of setrco, with C transposed, as answer().
+    void answer() {
+        matsize = matdim * matdim;
+        answ.assign(matsize * matsize, 0);
+        for (int c = 0; c < matsize; c++) {
+            for (int m = 0; m < matdim; m++) {
+                int a = (c % matdim) * matdim + m;
+                int b = c / matdim + matdim * m;
+                answ[b + matsize * c] |= 1ULL << a;
+            }
+        }
+    }
+
+    // Text of a tensor drawn as a square, the number of entries in C for each entry of A and B, as matstr.
+    std::string matstr(const std::vector<vlong>& t) {
+        return tensorstr(t, matdim);
+    }
+
+    // Text of a scheme as printed by MultSet, as a table or one line, with its error against the answer.
+    std::string scheme(const std::vector<vlong>& m, vlong flips) {
+        std::vector<vlong> t = answ;
+        for (size_t i = 0; i < m.size(); i += 3) {
+            toggle(t, m[i], m[i + 1], m[i + 2]);
+        }
+        int err = 0;
+        for (vlong w : t) {
+            err += bitcount(w);
+        }
+        std::string s;
+        if (style == 1) {
+            s = std::to_string(run) + " Muls: " + std::to_string(m.size() / 3) + " [ ";
+            for (size_t i = 0; i < m.size(); i += 3) {
+                s += std::to_string(bitcount(m[i]) * bitcount(m[i + 1]) * bitcount(m[i + 2])) + " ";
+            }
+            return s + "] Flips: " + std::to_string(flips) + " Error: " + std::to_string(err);
+        }
+        s = "\n";
+        if (matdim <= 6 && !m.empty()) {
+            s += "Multiplication set (" + std::to_string(m.size() / 3) + "):\nR: |";
+            for (int d = 0; d < 3; d++) {
+                for (int i = 0; i < matsize; i++) {
+                    s += (char)('1' + (d < 2 ? i / matdim : i % matdim));
+                }
+                s += d < 2 ? "|    |" : "|\nC: |";
+            }
+            for (int d = 0; d < 3; d++) {
+                for (int i = 0; i < matsize; i++) {
+                    s += (char)('1' + (d < 2 ? i % matdim : i / matdim));
+                }
+                s += d < 2 ? "|    |" : "|\n";
+            }
+            s += std::string(3 * matsize + 31, '-') + "\n";
+        }
+        for (size_t i = 0; matdim <= 6 && i < m.size(); i += 3) {
+            for (int d = 0; d < 3; d++) {
+                s += d == 0 ? "A: |" : d == 1 ? "| B: |" : "| C: |";
+                for (int j = 0; j < matsize; j++) {
+                    s += (char)('0' + (m[i + d] >> j & 1));
+                }
+            }
+            char z[16];
+            snprintf(z, sizeof(z), "| %3d%4d\n", (int)(i / 3), bitcount(m[i]) * bitcount(m[i + 1]) * bitcount(m[i + 2]));
+            s += z;
+        }
+        return s + matstr(t) + "Run: " + std::to_string(run) + " Flips: " + std::to_string(flips) + " Error: " + std::to_string(err) + "\n";
+    }
+
+    // Lift a scheme just saved in the store under name to integer coefficients if LIFT: is on, writing it to the
+    // results folder in the signed form, and print the outcome, as liftsaved in MatrixMult22.py.
+    void liftsaved(const std::vector<vlong>& m, const std::string& name) {
+        if (!lift || name.empty()) {
+            return;
+        }
+        fgformat format(matdim, 1, 1);
+        std::string s = liftscheme(format, "results/" + name, m, 8);
+        if (print >= 0) std::cout << s.substr(s.find(' ', s.find("Muls: ") + 6) + 1) << "\n";
+    }
+
+    // Append lines to runlog.txt, each after the seed.
+    void log(const std::string& s) {
+        if (writelog == 1) {
+            std::ofstream f("runlog.txt", std::ios::app);
+            f << zfill(rseed, 10) << s << "\n";
+        }
+    }
+
+    // Report the campaign settings before the first solve, as standardrun and runfromfile.
+    void details(int l) {
+        std::string s = "Size: " + std::to_string(matdim) + " Cubes: " + std::to_string(l) + " Target: " + std::to_string(target) + " Symm: " + std::to_string(symm);
+        if (save > 0) s += " Save <=: " + std::to_string(save);
+        if (save == -1) s += " Save: All";
+        std::string t = "Flip limit: " + std::to_string(flimit);
+        if (termination == 1) t += "(E)";
+        if (termination == 2) t += "(R)";
+        if (termination > 2) t += "(S" + std::to_string(termination) + (rt == 0 ? ":" + std::to_string(split) + "%)" : ")");
+        if (plusafter > 0) t += " Plus after: " + std::to_string(plusafter);
+        if (plusrandom == 1 && plusafter > 0) t += "(R)";
+        if (pluslimit > 0) t += " Plus limit: " + std::to_string(pluslimit);
+        if (maxsize < 0) t += " Maximum length: " + std::to_string(-maxsize);
+        else if (maxsize > 0) t += " Maximum volume: " + std::to_string(maxsize);
+        if (opts.lookahead > 0) t += " Lookahead: " + std::to_string(opts.lookahead);
+        if (opts.backtrack > 0) t += " Backtrack: " + std::to_string(opts.backtrack);
+        if (opts.greedy > 0) t += " Greedy: " + std::to_string(opts.greedy) + "%";
+        if (opts.tabu > 0) t += " Tabu: " + std::to_string(opts.tabu);
+        if (opts.sentinel == 1) t += " Sentinel: continuous";
+        if (opts.walkers > 1) t += " Walkers: " + std::to_string(opts.walkers) + "/" + std::to_string(opts.restarts);
+        if (opts.shared != "-") t += " Shared pool: " + opts.shared;
+        if (opts.replicas > 1) t += " Replicas: " + std::to_string(opts.replicas) + "/" + std::to_string(opts.swapint);
+        t += " Seed streams: solver";
+        if (opts.hugepages > 0) t += std::string(" Huge pages: ") + (opts.hugepages == 1 ? "transparent" : "explicit");
+        if (opts.affinity >= 0) t += " CPU affinity: " + std::to_string(opts.affinity);
+        if (opts.hold > 0 && opts.forks > 0) t += " Hold: " + std::to_string(opts.hold) + "/" + std::to_string(opts.forks);
+        if (opts.branches > 1) t += " Branches: " + std::to_string(opts.branches) + " within " + std::to_string(opts.within);
+        if (predict >= 0) t += " Predictive termination: " + pyfloat(predict);
+        if (inflight > 1) t += " Concurrent solves: " + std::to_string(inflight);
+        if (opts.metrics > 0) t += " Metrics: " + pyfloat(opts.metrics) + "s " + opts.metricsfile;
+        if (opts.timelimit > 0) t += " Time limit: " + pyfloat(opts.timelimit) + "s";
+        if (opts.record != "-") t += " Record: " + opts.record;
+        if (lift) t += " Lift: on";
+        if (print >= 0) {
+            std::cout << (rt == 0 ? "New run - " : "Continuation run - ") << s << "\n" << t << "\n";
+        }
+        time_t now = time(NULL);
+        char when[32];
+        strftime(when, sizeof(when), "%d/%m/%Y %H:%M:%S", localtime(&now));
+        log(std::string(" Run at: ") + when + " " + s);
+        log(" " + t);
+    }
+
+    // Reduction rate model of loadrates, the number of runs then for each rank the walks reaching it, those
+    // reducing from it and the flips spent there.
+    long long loadrates(const std::string& rname, std::map<int, std::vector<long long>>& model) {
+        long long runs = 0;
+        std::ifstream f(rname);
+        std::string l;
+        while (std::getline(f, l)) {
+            std::istringstream w(l);
+            std::vector<std::string> a;
+            std::string x;
+            while (w >> x) {
+                a.push_back(x);
+            }
+            if (a.size() == 2 && a[0] == "runs") {
+                runs = std::stoll(a[1]);
+            }
+            else if (a.size() == 4) {
+                model[std::stoi(a[0])] = { std::stoll(a[1]), std::stoll(a[2]), std::stoll(a[3]) };
+            }
+        }
+        return runs;
+    }
+
+    // Write a reduction rate model read by loadrates.
+    void saverates(const std::string& rname, long long runs, std::map<int, std::vector<long long>>& model) {
+#ifdef _WIN32
+        _mkdir("results");
+#else
+        mkdir("results", 0777);
+#endif
+        std::ofstream f(rname);
+        f << "runs " << runs << "\n";
+        for (auto p = model.rbegin(); p != model.rend(); ++p) {
+            f << p->first << " " << p->second[0] << " " << p->second[1] << " " << p->second[2] << "\n";
+        }
+    }
+
+    // Solve a scheme as MultSet.solve, the symmetry groups in m, three masks per multiplication, with cubes of
+    // the l multiplications left out.  Runs with the lock released, slot k of those running at once.  Returns the
+    // outcome code and status text and leaves the reduced scheme in m, the flips in flips and the hash in hash.
+    int solveone(std::vector<vlong>& m, int maxplus, int l, int k, std::unique_lock<std::mutex>& hold, int& minmuls, vlong& flips, vlong& hash, std::string& st) {
+        int nomuls = (int)m.size() / 3;
+        fgsettings set = opts;
+        set.nomuls = nomuls;
+        set.flips = 0;
+        set.rcode = 9;
+        set.target = target - l;
+        if (set.target < 0) {
+            set.target += nomuls;
+        }
+        set.flimit = flimit;
+        long long plimit = plusrandom == 1 ? -(long long)plusafter : (long long)plusafter;
+        set.plimit = plimit == 0 ? flimit * 1007 : (vlong)plimit;
+        set.termination = termination;
+        if (set.termination > 2) {
+            set.termination -= l;
+            set.termination -= ((set.termination % symm) + symm) % symm;
+        }
+        set.rseed = 0;
+        set.symm = symm;
+        set.maxplus = maxplus;
+        set.split = split;
+        set.minmuls = nomuls;
+        set.maxsize = maxsize;
+        set.master = rseed;
+        set.run = run;
+        if (opts.affinity >= 0) {
+            set.affinity = opts.affinity + k * solvecpus();
+        }
+        set.hold = opts.hold > 0 ? opts.hold - l : 0;
+        set.forks = opts.hold > 0 ? opts.forks : 0;
+        set.predict = std::max(predict, 0.0);
+        if (opts.metrics <= 0) {
+            set.metricsfile = "-";
+        }
+        else if (inflight > 1) {
+            set.metricsfile = suffixed(opts.metricsfile, std::to_string(k));
+        }
+        if (opts.record != "-") {
+            set.record = suffixed(opts.record, zfill(rseed, 10) + "-" + zfill(run, 3));
+        }
+        std::vector<vlong> muls;
+        for (int i = 0; i < nomuls; i++) {
+            muls.push_back(m[3 * i]);
+        }
+        std::string rname = "results/rates-" + std::to_string(matdim) + "-" + std::to_string(symm) + "-" + std::to_string(l) + ".txt";
+        if (predict > 0) {
+            std::map<int, std::vector<long long>> model;
+            if (loadrates(rname, model) >= 10 && !model.empty()) {
+                int top = model.rbegin()->first;
+                set.rates.assign(top + 1, 0.0);
+                for (int r = set.target + 1; r <= top; r++) {
+                    auto p = model.find(r);
+                    set.rates[r] = p != model.end() ? (p->second[1] + 1.0) / (double)(p->second[2] + (long long)flimit) : 1.0 / (double)flimit;
+                }
+            }
+        }
+
+        // Solve with the lock released, so other solves can start and finish meanwhile.
+        int r = run;
+        auto t0 = std::chrono::steady_clock::now();
+        hold.unlock();
+        fgresult res = solve(set, muls, "", true);
+        double tt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        hold.lock();
+        run = r;
+        flips = res.flips;
+        int rcode = res.rcode;
+        int achieved = res.achieved;
+        minmuls = res.rank;
+        hash = res.hash;
+        muls = res.muls;
+        std::vector<vlong>& reach = res.reach;
+        if (predict >= 0 && !reach.empty()) {
+            // Add this walk's time at each rank it reached, and whether it reduced from there, to the model.
+            std::map<int, std::vector<long long>> model;
+            long long runs = loadrates(rname, model);
+            int count = (int)reach.size();
+            int from = minmuls + symm * (count - 1);
+            for (int i = 0; i < count; i++) {
+                int rk = from - i * symm;
+                std::vector<long long>& e = model[rk];
+                e.resize(3, 0);
+                e[0]++;
+                if (i + 1 < count) {
+                    e[1]++;
+                    e[2] += (long long)(reach[i + 1] - reach[i]);
+                }
+                else {
+                    e[2] += (long long)(flips - reach[i]);
+                }
+            }
+            saverates(rname, runs + 1, model);
+        }
+
+        // Rebuild the three multiplications of each group, as the solver stores only the first.
+        m.assign(3 * nomuls, 0);
+        for (int i = 0; i < nomuls; i++) {
+            int g = i - i % 3;
+            int me = g + (i % 3 + 2) % 3;
+            int mf = g + (i % 3 + 1) % 3;
+            m[3 * i] = muls[i];
+            m[3 * i + 1] = muls[me];
+            m[3 * i + 2] = muls[mf];
+        }
+        std::string spstr = tt > 0 ? std::to_string((long long)(60 * flips / tt / 1000000)) : "N/A";
+        if (print >= 2 && res.plus > 0) {
+            std::cout << "Plus transitions: " << res.plus << "\n";
+        }
+        const char* outcome[11] = { "Target achieved - ", "Flip limit reached - ", "Terminated early - ", "Weird shit happened - ", "Not implemented - ", "Divergence detected - ", "Escaped infinite loop - ", "Interrupted - ", "Time limit reached - ", "No result returned - " };
+        if (rcode == -1) {
+            st = achieved == set.target ? "Target achieved (zero neighbours) - " : "State with zero neighbours - ";
+        }
+        else {
+            st = rcode >= 0 && rcode <= 9 ? outcome[rcode] : "";
+        }
+        if (rcode == -1 && achieved == set.target) {
+            rcode = 0;
+        }
+        st += "Flips: " + std::to_string(flips) + " Speed: " + spstr + " megaflips/min";
+        if (opts.greedy > 0) st += " Reductions: " + std::to_string(res.reductions) + " Greedy: " + std::to_string(res.greedyflips);
+        if (res.swaps > 0) st += " Swaps: " + std::to_string(res.swaps);
+        if (res.branches > 0) st += " Branches: " + std::to_string(res.branches);
+        char hs[20];
+        snprintf(hs, sizeof(hs), "%016llx", hash);
+        st += std::string(" Hash: ") + hs;
+        return rcode;
+    }
+
+    // Room for plus transitions, as standardrun and runfromfile, adding empty groups to m or lowering maxplus.
+    void headroom(std::vector<vlong>& m, int& maxplus, int l) {
+        int h = pluslimit == 0 ? 0 : pluslimit - l - (int)m.size() / 3;
+        h -= ((h % symm) + symm) % symm;
+        if (h > 0) {
+            m.resize(m.size() + 3 * h, 0);
+        }
+        maxplus += h;
+    }
+
+    // Drop the empty multiplications of a solved scheme and add back the cubes.
+    void complete(std::vector<vlong>& m, const std::vector<vlong>& c) {
+        std::vector<vlong> out;
+        for (size_t i = 0; i < m.size(); i += 3) {
+            if (m[i] != 0 && m[i + 1] != 0 && m[i + 2] != 0) {
+                out.insert(out.end(), m.begin() + i, m.begin() + i + 3);
+            }
+        }
+        out.insert(out.end(), c.begin(), c.end());
+        m.swap(out);
+    }
+
+    // Print a solved scheme if it reached the target, or at higher print levels.
+    void show(const std::vector<vlong>& m, int best, vlong flips) {
+        if ((best == target && print >= 1) || print >= 2) {
+            std::cout << scheme(m, flips) << "\n";
+        }
+    }
+
+    // Symmetrised start scheme of the cubes, built once for all standard runs as MultSet(pattern=..., symm=...).
+    void startscheme() {
+        const std::vector<std::string>& words = hasfull ? fullc : diagc;
+        size_t width = hasfull ? matsize : matdim;
+        for (size_t i = 0; i < words.size() && words[i].size() == width; i++) {
+            vlong x = 0;
+            for (int y = 0; y < (int)width; y++) {
+                if (words[i][y] == '1') {
+                    x |= 1ULL << (hasfull ? y : y * matdim + y);
+                }
+            }
+            cubes.insert(cubes.end(), { x, x, x });
+        }
+        std::vector<vlong> left = answ;
+        for (size_t i = 0; i < cubes.size(); i += 3) {
+            toggle(left, cubes[i], cubes[i + 1], cubes[i + 2]);
+        }
+        psymm = 6;
+        for (int b = 0; b < matsize && psymm == 6; b++) {
+            for (int c = 0; c < matsize; c++) {
+                vlong w = left[b + matsize * c];
+                vlong r = left[(matsize - 1 - b) + matsize * (matsize - 1 - c)];
+                for (int a = 0; a < matsize; a++) {
+                    if ((w >> a & 1) != (r >> (matsize - 1 - a) & 1)) {
+                        psymm = 3;
+                    }
+                }
+            }
+        }
+        for (int a = 0; a < matsize; a++) {
+            for (int b = 0; b < matsize; b++) {
+                for (int c = 0; c < matsize; c++) {
+                    if (left[b + matsize * c] >> a & 1) {
+                        int s[6][3] = { { a, b, c }, { c, a, b }, { b, c, a } };
+                        for (int i = 0; i < 3; i++) {
+                            for (int d = 0; d < 3; d++) {
+                                s[i + 3][d] = matsize - 1 - s[i][d];
+                            }
+                        }
+                        for (int i = 0; i < psymm; i++) {
+                            pattern.insert(pattern.end(), { 1ULL << s[i][0], 1ULL << s[i][1], 1ULL << s[i][2] });
+                            left[s[i][1] + matsize * s[i][2]] ^= 1ULL << s[i][0];
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // One standard run, as standardrun.
+    void standardrun(int k, std::unique_lock<std::mutex>& hold) {
+        int l = (int)cubes.size() / 3;
+        if (run == 1) {
+            details(l);
+        }
+        std::vector<vlong> m = pattern;
+        int begin = (int)m.size() / 3;
+        int maxplus = begin;
+        headroom(m, maxplus, l);
+        int minmuls;
+        vlong flips, hash;
+        std::string st;
+        int code = solveone(m, maxplus, l, k, hold, minmuls, flips, hash, st);
+        int best = minmuls + l;
+        complete(m, cubes);
+
+        // Save results, skipping schemes already saved, and print.
+        std::pair<vlong, std::vector<vlong>> hkey(hash, cubes);
+        if (savedhashes.count(hkey) > 0) {
+            if (print >= 1) std::cout << "Duplicate scheme not saved.\n";
+        }
+        else if (code == 5) {
+            if (print >= 0) std::cout << "Scheme failed tensor check, not saved.\n";
+        }
+        else if (best <= save || (save == -1 && best < begin)) {
+            savedhashes.insert(hkey);
+            std::string sname = store->add(m, best);
+            if (sname.empty() && print >= 1) std::cout << "Duplicate scheme not saved.\n";
+            liftsaved(m, sname);
+        }
+        summary[std::min(best, 999)]++;
+        if (print >= 0) std::cout << "Run: " << run << " Best: " << best << " " << st << "\n";
+        log("/" + zfill(run, 3) + " Best: " + std::to_string(best) + " " + st);
+        show(m, best, flips);
+    }
+
+    // One continuation run from a saved scheme, as runfromfile.
+    void runfromfile(int k, std::unique_lock<std::mutex>& hold) {
+        int e = fname.empty() ? store->choose(start) : store->find(fname);
+        if (e < 0) {
+            if (!fname.empty()) std::cout << "Saved scheme " << fname << " not found.\n";
+            else if (start == -1) std::cout << "No saved solutions exist.\n";
+            else std::cout << "No saved solutions at " << start << " exist.\n";
+            return;
+        }
+        std::string from = store->name(e);
+        int begin = store->ents[e].rank;
+        std::vector<vlong> all = store->muls(e);
+        std::vector<vlong> c, m;
+        for (size_t i = 0; i < all.size(); i += 3) {
+            std::vector<vlong>& to = all[i] == all[i + 1] && all[i + 1] == all[i + 2] ? c : m;
+            to.insert(to.end(), all.begin() + i, all.begin() + i + 3);
+        }
+        int l = (int)c.size() / 3;
+        if (run == 1) {
+            details(l);
+        }
+        int maxplus = (int)m.size() / 3;
+        headroom(m, maxplus, l);
+        int minmuls;
+        vlong flips, hash;
+        std::string st;
+        int code = solveone(m, maxplus, l, k, hold, minmuls, flips, hash, st);
+        int best = minmuls + l;
+        complete(m, c);
+
+        // Save results if necessary, overwrite the start scheme if no improvement, skip schemes already saved.
+        std::pair<vlong, std::vector<vlong>> hkey(hash, c);
+        if (best < begin && savedhashes.count(hkey) > 0) {
+            if (print >= 1) std::cout << "Duplicate scheme not saved.\n";
+        }
+        else if (code == 5) {
+            if (print >= 0) std::cout << "Scheme failed tensor check, not saved.\n";
+        }
+        else if (best <= save || (save == -1 && best <= begin)) {
+            savedhashes.insert(hkey);
+            std::string sname = best == begin ? store->add(m, best, from) : store->add(m, best);
+            if (sname.empty() && best != begin && print >= 1) std::cout << "Duplicate scheme not saved.\n";
+            liftsaved(m, sname);
+        }
+        summary[std::min(best, 999)]++;
+        if (print >= 0) std::cout << "Run: " << run << " From: " << from << " Best: " << best << " " << st << "\n";
+        log("/" + zfill(run, 3) + " From: " + from + " Best: " + std::to_string(best) + " " + st);
+        std::ofstream hf("results/history.txt", std::ios::app);
+        hf << from << " " << begin << " " << best << " " << flips << "\n";
+        hf.close();
+        show(m, best, flips);
+    }
+
+    // Run solves until all are taken, slot k of those running at once.  Runs are taken in order under the lock.
+    void runsolves(int k) {
+        std::unique_lock<std::mutex> hold(lock);
+        while (taken < solves && !fgstopping.load()) {
+            run = ++taken;
+            if (rt == 0) {
+                standardrun(k, hold);
+            }
+            else {
+                runfromfile(k, hold);
+            }
+            std::cout.flush();
+        }
+    }
+
+    // Read the input file and run its campaign, returns non-zero on an input error.
+    int main(const char* iname) {
+        std::ifstream f(iname);
+        if (!f) {
+            std::cout << "Input file " << iname << " not found.\n";
+            return 1;
+        }
+        int flags = 0;
+        std::string line;
+        while (std::getline(f, line)) {
+            std::istringstream w(line);
+            std::vector<std::string> a;
+            std::string x;
+            while (w >> x) {
+                a.push_back(x);
+            }
+            if (a.empty() || a[0] == "#") {
+                continue;
+            }
+            int flag = keyword(a);
+            if (flag < 0) {
+                return 1;
+            }
+            flags |= flag;
+        }
+        if (flags != 65535) {
+            std::string b;
+            for (int i = 15; i >= 0; i--) {
+                if (!b.empty() || flags >> i & 1) b += '0' + (flags >> i & 1);
+            }
+            std::cout << "Missing input: " << (b.empty() ? "0" : b) << "\n";
+            return 1;
+        }
+        if (rt == 1 && start == 0 && fname.empty()) {
+            std::cout << "Error in input file.\n";
+            return 1;
+        }
+        if (arms > 0) {
+            std::cout << "ARM: lines are run by MatrixMult22.py only.\n";
+            return 1;
+        }
+        if (matdim < 2 || matdim > 8) {
+            std::cout << "Matrix size must be 2 to 8.\n";
+            return 1;
+        }
+
+        // Preliminaries.
+        if (print >= 0) std::cout << "Fast matrix multiplication search algorithm by Mike Poole - version 22.\n";
+        auto t0 = std::chrono::steady_clock::now();
+        if (rseed == -1) {
+            long long us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+#ifdef _WIN32
+            long long pid = _getpid();
+#else
+            long long pid = getpid();
+#endif
+            rseed = (us + 1000000 * pid) % 10000000000LL;
+        }
+        if (print >= 0) std::cout << "Random number seed: " << rseed << "\n";
+        answer();
+        if (print >= 0) std::cout << "Solution: " << matstr(answ) << "\n";
+        store = new fgstore(matdim, "results", (vlong)rseed, print >= 0);
+        if (rt == 0) {
+            startscheme();
+        }
+
+        // Run cases, up to inflight at once.
+        inflight = concurrent;
+        if (inflight == 0) {
+            inflight = (int)std::thread::hardware_concurrency() / solvecpus();
+        }
+        inflight = std::max(1, std::min(inflight, solves));
+        std::vector<std::thread> threads;
+        for (int k = 1; k < inflight; k++) {
+            threads.push_back(std::thread(&fgcampaign::runsolves, this, k));
+        }
+        runsolves(0);
+        for (std::thread& t : threads) {
+            t.join();
+        }
+
+        // Summary output.
+        std::string s = "Summary:";
+        for (int i = 0; i < 1000; i++) {
+            if (summary[i] > 0) s += " " + std::to_string(i) + "/" + std::to_string(summary[i]);
+        }
+        if (print >= 0) std::cout << s << "\n";
+        log(" " + s);
+
+        // Wrap up.
+        double tt = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        if (print >= 0) {
+            char ts[32];
+            snprintf(ts, sizeof(ts), "%.2f", tt);
+            std::cout << "\nTotal runs: " << taken << "\n\nRun complete - CPU time: " << ts << " seconds\n\n";
+        }
+        return 0;
+    }
+};
+
+// C++ implementation of original Python solver function.
+int main(int argc, char* argv[]) {
+
+    if (argc > 2 && std::strcmp(argv[1], "--campaign") == 0) {
+        catchsignals();
+        fgcampaign campaign;
+        return campaign.main(argv[2]);
+    }
+    if (argc > 2 && std::strcmp(argv[1], "--replay") == 0) {
+        return replay(argv[2], argc > 3 ? std::stoull(argv[3]) : 0);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--verify") == 0) {
+        return verifyschemes(argc, argv);
+    }
+    if (argc > 1 && std::strcmp(argv[1], "--lift") == 0) {
+        return liftschemes(argc, argv);
+    }
+    if (argc > 1 && argv[1][0] == '-' && argv[1][1] == '-') {
+        return convertschemes(argc, argv);
+    }
+
+    std::ifstream input_file(argv[1]);
+    fgsettings set;
+    std::vector<vlong> muls;
+    readinput(input_file, set, muls);
+    input_file.close();
+    catchsignals();
+    fgresult res = solve(set, muls, argv[1], true);
+    std::ofstream output_file(argv[1]);
+    writeresult(output_file, set, res);
 
     return 0;
 }
@@ -60,6 +60,21 @@ import os
 import subprocess
 import datetime
 import sys
+import math
+import json
+import socket
+import socketserver
+import threading
+import tempfile
+import shutil
+import struct
+import hashlib
+import mmap
+import ctypes
+import concurrent.futures
+import itertools
+import signal
+if os.name!='nt': import fcntl
 
 matdim=4
 runcase=1
@@ -68,8 +83,12 @@ matvecs=2**matsize
 row=[[0]*matsize for i in range(3)]
 col=[[0]*matsize for i in range(3)]
 odr=[[0]*matsize for i in range(3)]
+rcorder=1
 fastsolver='C:/Flip Graphs/FlipSolver22/x64/Release/FlipSolver22.exe'
 if not os.path.isfile(fastsolver): fastsolver=None
+fastlibrary='C:/Flip Graphs/FlipSolver22/x64/Release/FlipSolver22.dll'	# Solver built as a library, run in process.
+if not os.path.isfile(fastlibrary): fastlibrary=None
+solverlib=None
 
 ctrls=[		# Globally available editable controls.
 0,			# 0 - used to store run number.
@@ -88,11 +107,42 @@ ctrls=[		# Globally available editable controls.
 0,			# 13 - plus transition spacing, 0 uniform, 1 random sample from 2*plus frequency.
 0,			# 14 - maximum size, 0 umlimited, +ve limit on A*B*C, -ve limit on A, B and C.
 0,			# 15 - plus transition limit, 0 size of problem.
-0,			# 16 - unused.
+0,			# 16 - used to store best rank and outcome of last solve.
 0,			# 17 - frequency for plot evolution stored in ctrls[10] (Python solver only).
 0,			# 18 - unused.
 0,			# 19 - unused.
-0]			# 20 - unused.
+0,			# 20 - unused.
+0,			# 21 - lookahead flips after plus transition, undone unless rank drops, 0 never (C++ solver only).
+0,			# 22 - backtrack to best after flips without improvement, 0 never (C++ solver only).
+0,			# 23 - greedy percentage of flips taken from candidates that reduce at once, 0 never (C++ solver only).
+0,			# 24 - tabu window of recent states a flip may not return to, 0 none (C++ solver only).
+0,			# 25 - tensor fingerprint check, 0 at checkpoints, 1 after every flip (C++ solver only).
+1,			# 26 - number of walkers sharing an elite pool within a solve (C++ solver only).
+0,			# 27 - restarts from the elite pool per walker after its flip limit (C++ solver only).
+'-',		# 28 - name of scheme pool shared between solver processes, '-' none (C++ solver only).
+1,			# 29 - number of replicas exchanging plus transition intervals within a solve (C++ solver only).
+100000,		# 30 - flips per replica between exchanges (C++ solver only).
+0,			# 31 - solver seeds from Python random 0, or derived in the solver from seed and run number 1 (C++ solver only).
+0,			# 32 - huge pages for walk memory, 0 none, 1 transparent, 2 explicit (C++ solver only, Linux).
+-1,			# 33 - first CPU walkers are pinned to, -1 none (C++ solver only, Linux).
+0,			# 34 - hold rank a first walk runs to before forking, 0 none (C++ solver only).
+0,			# 35 - number of forks continuing from the hold rank (C++ solver only).
+0,			# 36 - ranks above target within which a walk branches (C++ solver only).
+0,			# 37 - number of branches run at once, 0 no branching (C++ solver only).
+-1,			# 38 - predictive termination ratio, -1 off, 0 record rank trajectories only (C++ solver only).
+-1,			# 39 - number of solves run at once, 0 one per core shared by the walkers of a solve, -1 not given (C++ solver only).
+0,			# 40 - seconds between writes of live metrics, 0 none (C++ solver only).
+'-',		# 41 - name of file live metrics are written to, '-' none (C++ solver only).
+0,			# 42 - wall clock seconds a solve may run, 0 no limit (C++ solver only).
+'-',		# 43 - name of flight records of single walk solves, seed and run number added, '-' none (C++ solver only).
+0]			# 44 - 1 to lift each scheme saved to integer coefficients, 0 not (C++ solver only).
+
+savedhashes=set()	# State hashes of schemes saved in this session, used to skip duplicates.
+inflight=1			# Number of solves running at once.
+runlock=None		# Held by the solve running Python code while several run at once, released while its solver runs.
+solveslot=threading.local()		# Place of the thread running a solve among those running at once.
+stopping=False		# Set on SIGTERM or SIGINT, the solves running end with their best schemes and no more start.
+children=set()		# Solver processes running.
 
 if ctrls[9]==0:
 	import matplotlib.pyplot as plt
@@ -100,6 +150,11 @@ if ctrls[9]==0:
 
 def main():
 	'''Fast matrix multiplication search algorithm - main program.'''
+	if len(sys.argv)>2 and sys.argv[1]=='--worker': worker(sys.argv[2]); return
+	if len(sys.argv)>3 and sys.argv[2]=='--coordinator': Campaign(sys.argv[1]).serve(sys.argv[3]); return
+	if len(sys.argv)>2 and sys.argv[1]=='--export': exportschemes(int(sys.argv[2]),sys.argv[3] if len(sys.argv)>3 else 'export'); return
+	if len(sys.argv)>2 and sys.argv[1]=='--verify': sys.exit(verifyschemes(int(sys.argv[2]),sys.argv[3:] or ['results']))
+	if len(sys.argv)>2 and sys.argv[1]=='--lift': sys.exit(liftschemes(int(sys.argv[2]),sys.argv[3:] or ['results']))
 	if len(sys.argv)>1: inputfile(sys.argv[1]); return
 
 	# Premilinaries.
@@ -129,10 +184,12 @@ def inputfile(iname):
 	# Read input file and override global settings.
 	if not os.path.exists(iname): print('Input file',iname,'not found.'); return
 	flags=0
+	ctrls[39]=-1
 	fname=None
 	start=0
 	diagc=None
 	fullc=None
+	arms=[]
 	with open(iname,'r') as f:
 		lines=f.readlines()
 		for l in lines:
@@ -140,15 +197,11 @@ def inputfile(iname):
 			if len(a)>0:
 				if a[0]!='#':
 					if a[0]=='MATRIX_SIZE:': matdim=int(a[1]); flags|=1<<0
-					if a[0]=='FLIP_LIMIT:': ctrls[2]=int(a[1]); flags|=1<<1
-					if a[0]=='TERMINATION_STRATEGY:':
-						if a[1]=='LIMIT': ctrls[1]=0; flags|=1<<2
-						elif a[1]=='EARLY': ctrls[1]=1; flags|=1<<2
-						elif a[1]=='RESET': ctrls[1]=2; flags|=1<<2
-						elif a[1]=='SPLIT': ctrls[1]=int(a[2]); ctrls[4]=int(a[3]); flags|=1<<2
-					if a[0]=='PLUS_TRANSITION_AFTER:': ctrls[12]=int(a[1]); flags|=1<<3
-					if a[0]=='PLUS_TRANSITION_LIMIT:': ctrls[15]=int(a[1]); flags|=1<<4
+					flags|=solverkeyword(a)
 					if a[0]=='NUMBER_OF_SOLVES:': ctrls[5]=int(a[1]); flags|=1<<5
+					if a[0]=='CONCURRENT_SOLVES:':
+						if a[1]=='AUTO': ctrls[39]=0
+						else: ctrls[39]=int(a[1])
 					if a[0]=='PRINT_OUTPUT:':
 						if a[1]=='NONE': ctrls[7]=-1; flags|=1<<6
 						elif a[1]=='SUMMARY': ctrls[7]=0; flags|=1<<6
@@ -167,19 +220,13 @@ def inputfile(iname):
 					if a[0]=='RANDOM_SEED:':
 						if a[1]=='AUTO': rseed=-1; flags|=1<<10
 						else: rseed=int(a[1]); flags|=1<<10
-					if a[0]=='PLUS_TRANSITION_RANDOM:':
-						if a[1]=='NO': ctrls[13]=0; flags|=1<<11
-						elif a[1]=='YES': ctrls[13]=1; flags|=1<<11
-					if a[0]=='MAXIMUM_SIZE:':
-						if a[1]=='NONE': ctrls[14]=0; flags|=1<<12
-						elif a[1]=='LENGTH': ctrls[14]=-int(a[2]); flags|=1<<12
-						elif a[1]=='VOLUME': ctrls[14]=int(a[2]); flags|=1<<12
 					if a[0]=='RUN_TYPE:':
 						if a[1]=='NEW': rt=0; flags|=1<<13
 						elif a[1]=='CONTINUATION': rt=1; flags|=1<<13
 					if a[0]=='TARGET:': target=int(a[1]); flags|=1<<14
 					if a[0]=='SYMMETRY:': symm=int(a[1]); flags|=1<<15
 					if a[0]=='SAVED_FILE:': fname=a[1]
+					if a[0]=='ARM:': arms.append({'set':armgroups(a[1:]),'text':' '.join(a[1:]).split(' #')[0],'n':0,'cpu':0.0,'reward':0.0,'best':None})
 					if a[0]=='SAVED_SIZE:':
 						if a[1]=='RANDOM': start=-1
 						else: start=int(a[1])
@@ -204,28 +251,22 @@ def inputfile(iname):
 	if flags!=65535: print('Missing input:',bin(flags)[2:]); return
 	if rt==1 and start==0 and fname==[]: print('Error in input file.'); return
 
-	# Set global size data.
-	matsize=matdim*matdim
-	matvecs=2**matsize
-	row=[[0]*matsize for i in range(3)]
-	col=[[0]*matsize for i in range(3)]
-	odr=[[0]*matsize for i in range(3)]
-
 	# Premilinaries.
 	if ctrls[7]>=0: print('Fast matrix multiplication search algorithm by Mike Poole - version 22.')
 	tt=time.time()
+	# Solves taking Python seeds finish in an order depending on timing, so a seeded run is only reproduced one at a time.
+	if ctrls[39]==-1: ctrls[39]=1 if rseed!=-1 and ctrls[31]==0 else 0
 	if rseed==-1: rseed=int(1000000*tt+1000000*os.getpid())%10000000000
 	ctrls[3]=rseed
 	random.seed(rseed)
 	if ctrls[7]>=0: print('Random number seed:',ctrls[3])
-	setrco(1)
-	answer()
+	setsize(matdim)
 	if ctrls[7]>=0: print('Solution:',matstr(answ))
 
-	# Run cases.
+	# Run cases, each with the parameter setting chosen by the scheduler if there are arms.
 	ctrls[11]=[0]*1000
-	for r in range(ctrls[5]):
-		ctrls[0]+=1
+	def onesolve():
+		if len(arms)>0: k,changed,before,t0=armstart(arms)
 		if rt==0:
 			if fullc!=None: mset=standardrun(fullc=fullc,target=target,symm=symm,save=save)
 			elif diagc!=None: mset=standardrun(diagc=diagc,target=target,symm=symm,save=save)
@@ -233,8 +274,11 @@ def inputfile(iname):
 		elif rt==1:
 			if fname==None: mset=runfromfile(start=start,target=target,symm=symm,save=save)
 			else: mset=runfromfile(fname=fname,target=target,symm=symm,save=save)
+		if len(arms)>0: armend(arms,k,changed,before,t0,target,symm)
+	runsolves(onesolve,len(arms)==0)
 
 	# Summary output.
+	if len(arms)>0: armsummary(arms)
 	if ctrls[7]>=0:
 		s='Summary:'
 		for i in range(1000):
@@ -253,13 +297,153 @@ def inputfile(iname):
 	tt=time.time()-tt
 	if ctrls[7]>=0: print(); print('Run complete - CPU time:',f'{tt:.2f}','seconds'); print()
 
+def solverkeyword(a):
+	'''Set solver controls from an input file line split into words, returns the flag of a required keyword.'''
+	f=0
+	if a[0]=='FLIP_LIMIT:': ctrls[2]=int(a[1]); f|=1<<1
+	if a[0]=='TERMINATION_STRATEGY:':
+		if a[1]=='LIMIT': ctrls[1]=0; f|=1<<2
+		elif a[1]=='EARLY': ctrls[1]=1; f|=1<<2
+		elif a[1]=='RESET': ctrls[1]=2; f|=1<<2
+		elif a[1]=='SPLIT': ctrls[1]=int(a[2]); ctrls[4]=int(a[3]); f|=1<<2
+	if a[0]=='PLUS_TRANSITION_AFTER:': ctrls[12]=int(a[1]); f|=1<<3
+	if a[0]=='PLUS_TRANSITION_LIMIT:': ctrls[15]=int(a[1]); f|=1<<4
+	if a[0]=='PLUS_TRANSITION_RANDOM:':
+		if a[1]=='NO': ctrls[13]=0; f|=1<<11
+		elif a[1]=='YES': ctrls[13]=1; f|=1<<11
+	if a[0]=='MAXIMUM_SIZE:':
+		if a[1]=='NONE': ctrls[14]=0; f|=1<<12
+		elif a[1]=='LENGTH': ctrls[14]=-int(a[2]); f|=1<<12
+		elif a[1]=='VOLUME': ctrls[14]=int(a[2]); f|=1<<12
+	if a[0]=='LOOKAHEAD:': ctrls[21]=int(a[1])
+	if a[0]=='BACKTRACK:': ctrls[22]=int(a[1])
+	if a[0]=='GREEDY:': ctrls[23]=int(a[1])
+	if a[0]=='TABU:': ctrls[24]=int(a[1])
+	if a[0]=='SENTINEL:':
+		if a[1]=='CHECKPOINT': ctrls[25]=0
+		elif a[1]=='CONTINUOUS': ctrls[25]=1
+	if a[0]=='WALKERS:': ctrls[26]=int(a[1])
+	if a[0]=='RESTARTS:': ctrls[27]=int(a[1])
+	if a[0]=='SHARED_POOL:': ctrls[28]=a[1]
+	if a[0]=='REPLICAS:': ctrls[29]=int(a[1])
+	if a[0]=='SWAP_INTERVAL:': ctrls[30]=int(a[1])
+	if a[0]=='SEED_STREAMS:':
+		if a[1]=='PYTHON': ctrls[31]=0
+		elif a[1]=='SOLVER': ctrls[31]=1
+	if a[0]=='HUGE_PAGES:':
+		if a[1]=='NONE': ctrls[32]=0
+		elif a[1]=='TRANSPARENT': ctrls[32]=1
+		elif a[1]=='EXPLICIT': ctrls[32]=2
+	if a[0]=='CPU_AFFINITY:':
+		if a[1]=='NONE': ctrls[33]=-1
+		else: ctrls[33]=int(a[1])
+	if a[0]=='HOLD_RANK:': ctrls[34]=int(a[1])
+	if a[0]=='FORKS:': ctrls[35]=int(a[1])
+	if a[0]=='BRANCH_WITHIN:': ctrls[36]=int(a[1])
+	if a[0]=='BRANCHES:': ctrls[37]=int(a[1])
+	if a[0]=='PREDICTIVE_TERMINATION:': ctrls[38]=float(a[1])
+	if a[0]=='METRICS:':
+		ctrls[40]=float(a[1])
+		if len(a)>2 and a[2]!='#': ctrls[41]=a[2]
+		else: ctrls[41]='metrics.prom'
+	if a[0]=='TIME_LIMIT:': ctrls[42]=float(a[1])
+	if a[0]=='RECORD:':
+		if a[1]=='NONE': ctrls[43]='-'
+		else: ctrls[43]=a[1]
+	if a[0]=='LIFT:': ctrls[44]=int(a[1]=='ON')
+	return f
+
+def armgroups(w):
+	'''Split the words after ARM: into groups, each an input file keyword with its values.'''
+	g=[]
+	for x in w:
+		if x=='#': break
+		if x[-1]==':': g.append([x])
+		elif len(g)>0: g[-1].append(x)
+	return g
+
+def cputime():
+	'''Processor time of this process and its finished solver processes, wall clock time on Windows.'''
+	if os.name=='nt': return time.time()
+	t=os.times()
+	return t.user+t.system+t.children_user+t.children_system
+
+def loadrates(rname):
+	'''Read a reduction rate model, the number of runs then for each rank the walks reaching it, those
+	reducing from it and the flips spent there.'''
+	runs=0; model={}
+	if os.path.exists(rname):
+		with open(rname,'r') as f:
+			for l in f:
+				a=l.split()
+				if len(a)==2 and a[0]=='runs': runs=int(a[1])
+				elif len(a)==4: model[int(a[0])]=[int(a[1]),int(a[2]),int(a[3])]
+	return runs,model
+
+def saverates(rname,runs,model):
+	'''Write a reduction rate model read by loadrates.'''
+	if not os.path.exists('results'): os.mkdir('results')
+	with open(rname,'w') as f:
+		f.write('runs '+str(runs)+'\n')
+		for r in sorted(model,reverse=True): f.write(str(r)+' '+' '.join(str(x) for x in model[r])+'\n')
+
+def armstart(arms):
+	'''Choose the setting for the next solve, each untried one first, then by upper confidence bound on reward
+	per CPU-second, and apply it.  Returns the setting, the controls changed and their values before.'''
+	k=-1
+	for i in range(len(arms)):
+		if arms[i]['n']==0: k=i; break
+	if k==-1:
+		n=sum(a['n'] for a in arms)
+		rate=[a['reward']/a['cpu'] for a in arms]
+		top=max(max(rate),1e-9)
+		score=[rate[i]+top*math.sqrt(2*math.log(n)/arms[i]['n']) for i in range(len(arms))]
+		k=score.index(max(score))
+	before=ctrls[:]
+	for g in arms[k]['set']: solverkeyword(g)
+	changed=[i for i in range(len(ctrls)) if ctrls[i]!=before[i]]
+	ctrls[16]=0
+	return k,changed,before,cputime()
+
+def armend(arms,k,changed,before,t0,target,symm):
+	'''Score the solve just run for its setting, reward halving for every symm ranks above target, and restore the controls.'''
+	cpu=max(cputime()-t0,0.001)
+	a=arms[k]
+	a['n']+=1; a['cpu']+=cpu
+	if ctrls[16]!=0:
+		best=ctrls[16][0]
+		a['reward']+=0.5**(max(best-target,0)/symm)
+		if a['best']==None or best<a['best']: a['best']=best
+	for i in changed: ctrls[i]=before[i]
+	s='Arm: '+str(k+1)+' CPU: '+f'{cpu:.1f}'+' seconds'
+	if ctrls[7]>=1: print(s)
+	if ctrls[8]==1:
+		with open('runlog.txt','a') as f: f.write(str(ctrls[3]).zfill(10)+'/'+str(ctrls[0]).zfill(3)+' '+s+'\n')
+
+def armsummary(arms):
+	'''Report how each setting did, reward per CPU-second, and which won.'''
+	lines=[]
+	w=-1
+	for i in range(len(arms)):
+		a=arms[i]
+		rate=0
+		if a['cpu']>0: rate=a['reward']/a['cpu']
+		if a['n']>0 and (w==-1 or rate>arms[w]['reward']/arms[w]['cpu']): w=i
+		s='Arm '+str(i+1)+': '+a['text']+' - Solves: '+str(a['n'])+' Best: '+str(a['best'])+' Reward per CPU-second: '+f'{rate:.3g}'
+		lines.append(s)
+	if w>=0: lines.append('Best setting: Arm '+str(w+1)+': '+arms[w]['text'])
+	for s in lines:
+		if ctrls[7]>=0: print(s)
+	if ctrls[8]==1:
+		with open('runlog.txt','a') as f:
+			for s in lines: f.write(str(ctrls[3]).zfill(10)+' '+s+'\n')
+
 def runmanager():
 	'''Step through the logic and report output for different run types.'''
 
 	# Series of standard runs, or runs from file.
 	ctrls[11]=[0]*1000
-	for r in range(ctrls[5]):
-		ctrls[0]+=1
+	def onesolve():
 		if matdim==2: # Suggest ctrls[2]=10000, ctrls[12]=0.
 			if runcase==0: # Strassen algorithm, 3-way symmetry.
 				mset=standardrun(diagc=['11'],target=7,symm=3)
@@ -325,6 +509,7 @@ def runmanager():
 		if matdim==7:
 			if runcase==1: # 1-cube, 6-way symmetry.
 				mset=standardrun(diagc=['1111111'],target=163,symm=6,save=163)
+	runsolves(onesolve)
 
 	# Overall summary.
 	if ctrls[7]>=0:
@@ -340,6 +525,71 @@ def runmanager():
 			s+='\n'
 			f.write(s)	
 
+def solvesignal(signum,frame):
+	'''Handler for SIGTERM and SIGINT, which stop the solves running with their best schemes so far and start no
+	more, and SIGUSR1, which is passed on to the solver processes for them to write recovery files.'''
+	global stopping
+	if signum!=getattr(signal,'SIGUSR1',None):
+		stopping=True
+		if solverlib!=None: solverlib.fgcancel(1)
+	if os.name!='nt':
+		for p in list(children): p.send_signal(signum)
+
+def runsolves(onesolve,together=True):
+	'''Run ctrls[5] solves numbered on from ctrls[0], calling onesolve with ctrls[0] set to the number of each, until
+	stopped by a signal to a C++ solver.'''
+	global stopping
+	stopping=False
+	if solverlib!=None: solverlib.fgcancel(0)
+	handlers=[]
+	if threading.current_thread() is threading.main_thread() and (fastsolver!=None or fastlibrary!=None):
+		for name in ['SIGTERM','SIGINT','SIGUSR1']:
+			if hasattr(signal,name): handlers.append((getattr(signal,name),signal.signal(getattr(signal,name),solvesignal)))
+	try: runsome(onesolve,together)
+	finally:
+		for sig,h in handlers: signal.signal(sig,h)
+
+def runsome(onesolve,together):
+	'''Run the solves of runsolves.  If together is set and a C++ solver is available, up to ctrls[39] run at once
+	in threads.  Each holds runlock while running Python code and releases it while its solver runs, taking it
+	first in run order, so the summary, log and results are shared as before and solves start in order.'''
+	global inflight,runlock
+	inflight=ctrls[39]
+	if inflight<=0: inflight=(os.cpu_count() or 1)//solvecpus()
+	if not together or (fastsolver==None and fastlibrary==None): inflight=1
+	inflight=max(1,min(inflight,ctrls[5]))
+	if inflight==1:
+		for r in range(ctrls[5]):
+			if stopping: break
+			ctrls[0]+=1
+			onesolve()
+		return
+	first=ctrls[0]+1
+	turn=[first]
+	last=[first-1]
+	runlock=threading.Condition(threading.Lock())
+	slots=itertools.count()
+	def slot(): solveslot.k=next(slots)
+	def run(r):
+		with runlock:
+			runlock.wait_for(lambda: turn[0]==r)
+			turn[0]+=1
+			if stopping: runlock.notify_all(); return
+			ctrls[0]=r; last[0]=r
+			try: onesolve()
+			finally: runlock.notify_all()
+	try:
+		with concurrent.futures.ThreadPoolExecutor(inflight,initializer=slot) as pool:
+			jobs=[pool.submit(run,first+r) for r in range(ctrls[5])]
+		for j in jobs: j.result()
+	finally:
+		runlock=None
+		ctrls[0]=last[0]
+
+def solvecpus():
+	'''Threads used by one solve, the most of its walkers, replicas, forks and branches.'''
+	return max(ctrls[26],ctrls[29],ctrls[35],ctrls[37],1)
+
 def standardrun(diagc=None,fullc=None,target=0,symm=3,save=0):
 	'''Carry out one standard run.'''
 
@@ -374,6 +624,25 @@ def standardrun(diagc=None,fullc=None,target=0,symm=3,save=0):
 		if ctrls[18]>0: t+=' Super: '+str(ctrls[18])+'/'+str(ctrls[19])
 		if ctrls[14]<0: t+=' Maximum length: '+str(-ctrls[14])
 		elif ctrls[14]>0: t+=' Maximum volume: '+str(ctrls[14])
+		if ctrls[21]>0: t+=' Lookahead: '+str(ctrls[21])
+		if ctrls[22]>0: t+=' Backtrack: '+str(ctrls[22])
+		if ctrls[23]>0: t+=' Greedy: '+str(ctrls[23])+'%'
+		if ctrls[24]>0: t+=' Tabu: '+str(ctrls[24])
+		if ctrls[25]==1: t+=' Sentinel: continuous'
+		if ctrls[26]>1: t+=' Walkers: '+str(ctrls[26])+'/'+str(ctrls[27])
+		if ctrls[28]!='-': t+=' Shared pool: '+ctrls[28]
+		if ctrls[29]>1: t+=' Replicas: '+str(ctrls[29])+'/'+str(ctrls[30])
+		if ctrls[31]==1: t+=' Seed streams: solver'
+		if ctrls[32]>0: t+=' Huge pages: '+['transparent','explicit'][ctrls[32]-1]
+		if ctrls[33]>=0: t+=' CPU affinity: '+str(ctrls[33])
+		if ctrls[34]>0 and ctrls[35]>0: t+=' Hold: '+str(ctrls[34])+'/'+str(ctrls[35])
+		if ctrls[37]>1: t+=' Branches: '+str(ctrls[37])+' within '+str(ctrls[36])
+		if ctrls[38]>=0: t+=' Predictive termination: '+str(ctrls[38])
+		if inflight>1: t+=' Concurrent solves: '+str(inflight)
+		if ctrls[40]>0: t+=' Metrics: '+str(ctrls[40])+'s '+ctrls[41]
+		if ctrls[42]>0: t+=' Time limit: '+str(ctrls[42])+'s'
+		if ctrls[43]!='-': t+=' Record: '+ctrls[43]
+		if ctrls[44]==1: t+=' Lift: on'
 		if ctrls[7]>=0:
 			print('New run -',s)
 			print(t)
@@ -409,19 +678,23 @@ def standardrun(diagc=None,fullc=None,target=0,symm=3,save=0):
 	for m in dset.muls: mset.muls.append(m); mset.nomuls+=1
 	mset.evalall()
 
-	# Save results, and print.
-	if best<=save or (save==-1 and best<start):
-		if not os.path.exists('results'): os.mkdir('results')
-		rf=random.randrange(10000000000)
-		while True:
-			fname='results/m'+str(best).zfill(3)+'r'+str(rf).zfill(10)+'.txt'
-			if not os.path.exists(fname): break
-			rf+=1
-		mset.writesol(fname)	
+	# Save results, skipping schemes already saved, and print.
+	hkey=None
+	if mset.hash!=None: hkey=(mset.hash,str(dset.muls))
+	if hkey in savedhashes:
+		if ctrls[7]>=1: print('Duplicate scheme not saved.')
+	elif code==5:
+		if ctrls[7]>=0: print('Scheme failed tensor check, not saved.')
+	elif best<=save or (save==-1 and best<start):
+		if hkey!=None: savedhashes.add(hkey)
+		sname=schemes().add(mset.muls,best)
+		if sname==None and ctrls[7]>=1: print('Duplicate scheme not saved.')
+		liftsaved(sname)
 	if ctrls[17] and fastsolver==None:
 		ctrls[10]=[x+l for x in ctrls[10]]
 		plotres(ctrls[10])
 	ctrls[11][best]+=1
+	ctrls[16]=(best,st)
 	if ctrls[7]>=0: print('Run:',ctrls[0],'Best:',best,st)
 	if ctrls[8]==1:
 		with open('runlog.txt','a') as f:
@@ -438,26 +711,23 @@ def runfromfile(fname=None,start=0,target=0,symm=3,save=0):
 	'''Load initial guess from file and then run.'''
 	hname='results/history.txt'
 
-	# Choose file as start point.
+	# Choose saved scheme as start point.
+	store=schemes()
 	if fname==None:
 		if start==0: print('Need either filename or specified start point.'); return
-		if start==-1: 
-			rfiles='results/m*.txt'
-			fnames=glob.glob(rfiles)
-			if len(fnames)==0: print('No saved solutions exist.'); return
-			fname=random.choice(fnames)
-			start=int(fname[9:12])
-		else:
-			rfiles='results/m'+str(start).zfill(3)+'*.txt'
-			fnames=glob.glob(rfiles)
-			if len(fnames)==0: print('No saved solutions at',start,'exist.'); return
-			fname=random.choice(fnames)
+		e=store.choose(start)
+		if e==None:
+			if start==-1: print('No saved solutions exist.')
+			else: print('No saved solutions at',start,'exist.')
+			return
 	else:
-		fname='results/'+fname
-		start=int(fname[9:12])
+		e=store.find(fname)
+		if e==None: print('Saved scheme',fname,'not found.'); return
+	fname=store.name(e)
+	start=store.ents[e][2]
 
 	# Load chosen result.
-	fset=MultSet(fname=fname)
+	fset=store.load(e)
 	dset=MultSet()
 	mset=MultSet()
 	for m in fset.muls:
@@ -481,6 +751,25 @@ def runfromfile(fname=None,start=0,target=0,symm=3,save=0):
 		if ctrls[18]>0: t+=' Super: '+str(ctrls[18])+'/'+str(ctrls[19])
 		if ctrls[14]<0: t+=' Maximum length: '+str(-ctrls[14])
 		elif ctrls[14]>0: t+=' Maximum volume: '+str(ctrls[14])
+		if ctrls[21]>0: t+=' Lookahead: '+str(ctrls[21])
+		if ctrls[22]>0: t+=' Backtrack: '+str(ctrls[22])
+		if ctrls[23]>0: t+=' Greedy: '+str(ctrls[23])+'%'
+		if ctrls[24]>0: t+=' Tabu: '+str(ctrls[24])
+		if ctrls[25]==1: t+=' Sentinel: continuous'
+		if ctrls[26]>1: t+=' Walkers: '+str(ctrls[26])+'/'+str(ctrls[27])
+		if ctrls[28]!='-': t+=' Shared pool: '+ctrls[28]
+		if ctrls[29]>1: t+=' Replicas: '+str(ctrls[29])+'/'+str(ctrls[30])
+		if ctrls[31]==1: t+=' Seed streams: solver'
+		if ctrls[32]>0: t+=' Huge pages: '+['transparent','explicit'][ctrls[32]-1]
+		if ctrls[33]>=0: t+=' CPU affinity: '+str(ctrls[33])
+		if ctrls[34]>0 and ctrls[35]>0: t+=' Hold: '+str(ctrls[34])+'/'+str(ctrls[35])
+		if ctrls[37]>1: t+=' Branches: '+str(ctrls[37])+' within '+str(ctrls[36])
+		if ctrls[38]>=0: t+=' Predictive termination: '+str(ctrls[38])
+		if inflight>1: t+=' Concurrent solves: '+str(inflight)
+		if ctrls[40]>0: t+=' Metrics: '+str(ctrls[40])+'s '+ctrls[41]
+		if ctrls[42]>0: t+=' Time limit: '+str(ctrls[42])+'s'
+		if ctrls[43]!='-': t+=' Record: '+ctrls[43]
+		if ctrls[44]==1: t+=' Lift: on'
 		if ctrls[7]>=0:
 			print('Continuation run -',s)
 			print(t)
@@ -506,25 +795,28 @@ def runfromfile(fname=None,start=0,target=0,symm=3,save=0):
 	for m in dset.muls: mset.muls.append(m); mset.nomuls+=1
 	mset.evalall()
 
-	# Save results if necessary, overwrite start file if no improvement, and print.
-	if best<=save or (save==-1 and best<=start):
-		if not os.path.exists('results'): os.mkdir('results')
-		if best==start: sname=fname
-		else:
-			rf=random.randrange(10000000000)
-			while True:
-				sname='results/m'+str(best).zfill(3)+'r'+str(rf).zfill(10)+'.txt'
-				if not os.path.exists(sname): break
-				rf+=1
-		mset.writesol(sname)
+	# Save results if necessary, overwrite start file if no improvement, skip schemes already saved, and print.
+	hkey=None
+	if mset.hash!=None: hkey=(mset.hash,str(dset.muls))
+	if best<start and hkey in savedhashes:
+		if ctrls[7]>=1: print('Duplicate scheme not saved.')
+	elif code==5:
+		if ctrls[7]>=0: print('Scheme failed tensor check, not saved.')
+	elif best<=save or (save==-1 and best<=start):
+		if hkey!=None: savedhashes.add(hkey)
+		if best==start: sname=store.add(mset.muls,best,fname)
+		else: sname=store.add(mset.muls,best)
+		if sname==None and best!=start and ctrls[7]>=1: print('Duplicate scheme not saved.')
+		liftsaved(sname)
 	if ctrls[17] and fastsolver==None:
 		ctrls[10]=[x+l for x in ctrls[10]]
 		plotres(ctrls[10])
 	ctrls[11][best]+=1
-	if ctrls[7]>=0: print('Run:',ctrls[0],'From:',fname[8:],'Best:',best,st)
+	ctrls[16]=(best,st)
+	if ctrls[7]>=0: print('Run:',ctrls[0],'From:',fname,'Best:',best,st)
 	if ctrls[8]==1:
 		with open('runlog.txt','a') as f:
-			s=str(ctrls[3]).zfill(10)+'/'+str(ctrls[0]).zfill(3)+' From: '+fname[8:]+' Best: '+str(best)+' '+st+'\n'
+			s=str(ctrls[3]).zfill(10)+'/'+str(ctrls[0]).zfill(3)+' From: '+fname+' Best: '+str(best)+' '+st+'\n'
 			f.write(s)
 
 	# Update history file.
@@ -540,6 +832,542 @@ def runfromfile(fname=None,start=0,target=0,symm=3,save=0):
 		if ctrls[7]>=2: print(mset)
 		return None
 
+class SchemeStore:
+	'''Append-only binary store of the schemes saved in a results folder.
+	schemes.bin holds each scheme as its multiplications, three 64-bit words each, in the order the solver
+	takes them.  schemes.idx holds a fixed-width entry per scheme giving matrix size, flags, rank, name number,
+	offset in schemes.bin and a hash of the multiplications independent of their order.  The entry is written
+	after the scheme, so a scheme is only seen once complete.  A scheme saved again under its old name, when a
+	continuation run does not improve on its start, is appended and the earlier entry flagged as replaced.
+	Schemes are read through a memory map, and the entries are kept in lists by size and rank, so choosing a
+	start of a given rank, or of any rank, takes constant time.'''
+
+	entry=struct.Struct('<BBH4xQQQ')
+	REPLACED=1
+
+	def __init__(self,folder='results'):
+		'''Open the store in folder, importing any text scheme files there the first time.'''
+		self.folder=os.path.abspath(folder)
+		self.bname=os.path.join(self.folder,'schemes.bin')
+		self.iname=os.path.join(self.folder,'schemes.idx')
+		self.ents=[]		# Entries read, each [size, flags, rank, name number, offset, hash].
+		self.live={}		# (size, rank) and (size, -1) to numbers of entries not replaced.
+		self.pos={}			# (size, rank, entry) to its place in the live list.
+		self.names={}		# (size, rank, name number) to latest entry.
+		self.hashes=set()	# (size, hash) of entries not replaced.
+		self.bfile=None; self.bmap=None
+		if not os.path.exists(self.iname):
+			tnames=sorted(glob.glob(os.path.join(self.folder,'m*.txt')))
+			if len(tnames)>0: self.importtext(tnames)
+		self.refresh()
+
+	def close(self):
+		'''Release the memory map.'''
+		if self.bmap!=None: self.bmap.close(); self.bmap=None
+		if self.bfile!=None: self.bfile.close(); self.bfile=None
+
+	def importtext(self,tnames):
+		'''Add text scheme files, taken to be of the current size, keeping their names.'''
+		n=0
+		tnames=[tn for tn in tnames if os.path.basename(tn)[5:-4].isdigit()]
+		for tn,muls in zip(tnames,readschemes(tnames)):
+			if self.add(muls,len(muls),os.path.basename(tn))!=None: n+=1
+		if ctrls[7]>=0: print('Imported',n,'text schemes into',self.iname)
+
+	def link(self,e):
+		'''Add entry e to the live lists.'''
+		size,flags,rank,rf,off,h=self.ents[e]
+		for k in ((size,rank),(size,-1)):
+			l=self.live.setdefault(k,[])
+			self.pos[k+(e,)]=len(l)
+			l.append(e)
+		self.hashes.add((size,h))
+
+	def unlink(self,e):
+		'''Remove entry e from the live lists, moving the last entry of each into its place.'''
+		size,flags,rank,rf,off,h=self.ents[e]
+		for k in ((size,rank),(size,-1)):
+			l=self.live[k]
+			i=self.pos.pop(k+(e,))
+			last=l.pop()
+			if last!=e: l[i]=last; self.pos[k+(last,)]=i
+		self.hashes.discard((size,h))
+
+	def refresh(self):
+		'''Read index entries added since the last call, by this or another process.'''
+		if not os.path.exists(self.iname): return
+		n=len(self.ents)
+		with open(self.iname,'rb') as f:
+			f.seek(n*self.entry.size)
+			data=f.read()
+		for i in range(len(data)//self.entry.size):
+			e=n+i
+			self.ents.append(list(self.entry.unpack_from(data,i*self.entry.size)))
+			size,flags,rank,rf,off,h=self.ents[e]
+			old=self.names.get((size,rank,rf))
+			if old!=None and self.ents[old][1]&self.REPLACED==0:
+				self.ents[old][1]|=self.REPLACED; self.unlink(old)
+			self.names[(size,rank,rf)]=e
+			if flags&self.REPLACED==0: self.link(e)
+
+	def digest(self,muls):
+		'''Hash of the multiplications, independent of their order.'''
+		return int.from_bytes(hashlib.blake2b(str(sorted(muls)).encode(),digest_size=8).digest(),'little')
+
+	def name(self,e):
+		'''Name of entry e.'''
+		return 'm'+str(self.ents[e][2]).zfill(3)+'r'+str(self.ents[e][3]).zfill(10)
+
+	def find(self,name):
+		'''Latest entry saved under name (a trailing .txt is ignored), or None.'''
+		self.refresh()
+		if name.endswith('.txt'): name=name[:-4]
+		if len(name)<6 or not name[1:4].isdigit() or not name[5:].isdigit(): return None
+		return self.names.get((matdim,int(name[1:4]),int(name[5:])))
+
+	def choose(self,rank):
+		'''Random entry of the current size and given rank, or of any rank if rank is -1, or None.'''
+		self.refresh()
+		l=self.live.get((matdim,rank),[])
+		if len(l)==0: return None
+		return random.choice(l)
+
+	def muls(self,e):
+		'''Multiplications of entry e.'''
+		size,flags,rank,rf,off,h=self.ents[e]
+		if self.bmap==None or off+24*rank>len(self.bmap):
+			self.close()
+			self.bfile=open(self.bname,'rb')
+			self.bmap=mmap.mmap(self.bfile.fileno(),0,access=mmap.ACCESS_READ)
+		w=struct.unpack_from('<'+str(3*rank)+'Q',self.bmap,off)
+		return [list(w[i:i+3]) for i in range(0,3*rank,3)]
+
+	def load(self,e):
+		'''MultSet holding entry e.'''
+		mset=MultSet()
+		mset.muls=self.muls(e)
+		mset.nomuls=len(mset.muls)
+		mset.evalall()
+		return mset
+
+	def add(self,muls,rank,name=None):
+		'''Append a scheme of the current size, under name if given, replacing the scheme saved under it, or
+		else under a new random name.  Returns the name, or None if the same scheme is already in the store.'''
+		self.refresh()
+		h=self.digest(muls)
+		if (matdim,h) in self.hashes: return None
+		if not os.path.exists(self.folder): os.mkdir(self.folder)
+		with open(self.iname,'ab') as fi:
+			if os.name!='nt': fcntl.flock(fi,fcntl.LOCK_EX)
+			self.refresh()
+			if (matdim,h) in self.hashes:
+				if os.name!='nt': fcntl.flock(fi,fcntl.LOCK_UN)
+				return None
+			if name!=None:
+				if name.endswith('.txt'): name=name[:-4]
+				rf=int(name[5:])
+			else:
+				rf=random.randrange(10000000000)
+				while (matdim,rank,rf) in self.names: rf+=1
+			with open(self.bname,'ab') as fb:
+				off=fb.seek(0,2)
+				fb.write(struct.pack('<'+str(3*rank)+'Q',*[x for m in muls for x in m]))
+			fi.write(self.entry.pack(matdim,0,rank,rf,off,h))
+			fi.flush()
+			old=self.names.get((matdim,rank,rf))
+			if old!=None:
+				with open(self.iname,'r+b') as fr:
+					fr.seek(old*self.entry.size+1)
+					fr.write(bytes([self.ents[old][1]|self.REPLACED]))
+			if os.name!='nt': fcntl.flock(fi,fcntl.LOCK_UN)
+		self.refresh()
+		return 'm'+str(rank).zfill(3)+'r'+str(rf).zfill(10)
+
+store=None
+
+def schemes():
+	'''Scheme store of the results folder in the current directory.'''
+	global store
+	if store==None or store.folder!=os.path.abspath('results'):
+		if store!=None: store.close()
+		store=SchemeStore()
+	return store
+
+def exportschemes(n,folder):
+	'''Write the schemes for n x n matrices in the store as text files in folder.'''
+	setsize(n)
+	s=schemes()
+	if not os.path.exists(folder): os.mkdir(folder)
+	l=s.live.get((matdim,-1),[])
+	writeschemes([(os.path.join(folder,s.name(e)+'.txt'),s.muls(e)) for e in l])
+	print('Exported',len(l),'schemes to',folder)
+
+def schemefile(s,lifted=True):
+	'''True if a file name is that of a scheme, m<rank>r<digits>.txt as in a results folder or <sizes>m<rank>.txt as in
+	the schemes folder, with _lifted before .txt only if lifted is set, so history and rates files are passed over.'''
+	if not s.endswith('.txt'): return False
+	s=s[:-4]
+	if s.endswith('_lifted'):
+		if not lifted: return False
+		s=s[:-7]
+	a,m,b=s.partition('m')
+	if m!='m' or not (a=='' or a.isdigit()): return False
+	if b.isdigit(): return True
+	b,r,c=b.partition('r')
+	return a=='' and r=='r' and b.isdigit() and c.isdigit()
+
+def loadlifted(fname):
+	'''Read a lifted scheme with its coefficients reduced mod 2, as the C++ solver reads it, returning the
+	multiplications as masks.'''
+	muls=[]
+	with open(fname) as f:
+		for l in f:
+			e=[[],[],[]]; co=1
+			for tk in l.translate(str.maketrans('()*+-','     ')).split():
+				if tk.isdigit(): co=int(tk)
+				elif len(tk)==3 and tk[0] in 'abc':
+					v=(int(tk[1])-1)*matdim+int(tk[2])-1
+					if co%2==1: e['abc'.index(tk[0])].append(odr[min('abc'.index(tk[0]),1)][v])
+					co=1
+			if l.strip()!='': muls.append([convert(e[0]),convert(e[1]),convert(e[2])])
+	return [m for m in muls if m!=[0,0,0]]
+
+def verifyschemes(n,paths):
+	'''Check the scheme files, and the text schemes and store of each folder, in paths against the answer, by the
+	C++ solver in parallel if there is one, else by evalall.  Prints a line for each scheme, with its residual if it
+	has errors, and returns the solver's exit code, 0 if all are correct.'''
+	setsize(n)
+	if fastsolver!=None:
+		r=subprocess.run([fastsolver,'--verify',str(matdim),str(rcorder),'1']+paths)
+		return r.returncode
+	items=[]
+	for path in paths:
+		if not os.path.isdir(path): items.append((path,None)); continue
+		tnames=sorted(fn for fn in glob.glob(os.path.join(path,'*.txt')) if schemefile(os.path.basename(fn)))
+		items+=[(fn,None) for fn in tnames]
+		if os.path.exists(os.path.join(path,'schemes.idx')):
+			s=SchemeStore(path)
+			seen=set(os.path.basename(fn) for fn in tnames)
+			items+=[(os.path.join(path,s.name(e)),s.muls(e)) for e in s.live.get((matdim,-1),[]) if s.name(e)+'.txt' not in seen]
+			s.close()
+	rc=0; bad=0
+	for name,muls in items:
+		mset=MultSet()
+		if muls==None:
+			if not os.path.exists(name): print(name,'Cannot open.'); rc=1; bad+=1; continue
+			if name.endswith('_lifted.txt'): muls=loadlifted(name)
+			else:
+				mset.loadsol(name)
+				muls=[m for m in mset.muls if m!=[0,0,0]]
+		mset.muls=muls; mset.nomuls=len(muls)
+		mset.evalall()
+		print(name,'Muls:',len(muls),'Error:',mset.err)
+		if mset.err>0: print(matstr(mset.curr),end=''); rc=rc or 2; bad+=1
+	print('Verified',len(items),'schemes,',bad,'with errors.')
+	return rc
+
+def liftschemes(n,paths):
+	'''Lift the scheme files, and the text schemes and store of each folder, in paths to integer coefficients by the
+	C++ solver, writing those that lift beside them with _lifted added to their names.  Returns the exit code, 0 if
+	all lift.'''
+	setsize(n)
+	if fastsolver==None: print('Lifting needs the C++ solver.'); return 1
+	r=subprocess.run([fastsolver,'--lift',str(matdim),str(rcorder),'1']+paths)
+	return r.returncode
+
+def liftsaved(name):
+	'''Lift a scheme just saved in the store under name to integer coefficients if LIFT: is on, writing it to the
+	results folder in the signed form, and print the outcome.'''
+	if ctrls[44]==0 or name==None: return
+	if fastsolver==None:
+		if ctrls[7]>=0: print('Lifting needs the C++ solver, LIFT: ignored.')
+		ctrls[44]=0; return
+	r=subprocess.run([fastsolver,'--lift',str(matdim),str(rcorder),'1',os.path.join('results',name)],capture_output=True,text=True)
+	l=r.stdout.split('\n')[0].split()
+	if ctrls[7]>=0 and len(l)>3: print(' '.join(l[3:]))
+
+def runsolver(iname,text):
+	'''Run a solve given as text in the interface file format and return the outcome in the same format, in the
+	solver library if it is loaded, else by the solver program or the Python solver through the file iname.'''
+	global solverlib
+	if fastlibrary!=None and solverlib==None:
+		solverlib=ctypes.CDLL(fastlibrary)
+		solverlib.fgsolve.argtypes=[ctypes.c_char_p]
+		solverlib.fgsolve.restype=ctypes.c_void_p
+		solverlib.fgfree.argtypes=[ctypes.c_void_p]
+		solverlib.fgcancel.argtypes=[ctypes.c_int]
+	if fastlibrary==None:
+		with open(iname,'w') as f: f.write(text)
+	# Let other solves run their Python code while this one's solver runs.
+	lock=runlock
+	if lock!=None: run=ctrls[0]; lock.notify_all(); lock.release()
+	try:
+		if fastlibrary!=None:
+			if threading.current_thread() is threading.main_thread():
+				# Solve in another thread so signal handlers run while it solves.
+				with concurrent.futures.ThreadPoolExecutor(1) as pool: p=pool.submit(solverlib.fgsolve,text.encode()).result()
+			else: p=solverlib.fgsolve(text.encode())
+			out=ctypes.string_at(p).decode()
+			solverlib.fgfree(p)
+			return out
+		if fastsolver==None: flipsolver(iname)
+		else:
+			p=subprocess.Popen([fastsolver,iname])
+			children.add(p)
+			try: p.wait()
+			finally: children.discard(p)
+	finally:
+		if lock!=None: lock.acquire(); ctrls[0]=run
+	with open(iname,'r') as f: out=f.read()
+	os.remove(iname)
+	return out
+
+def fastsolve(header,muls,rates=None):
+	'''Solve in the solver library or program, for scripted experiments.  header is the interface file header line,
+	muls the first multiplication of each symmetry group as passed by MultSet.solve and rates any reduction rates
+	as (rank, rate) pairs.  Returns (rcode, flips, minmuls, plus, muls).  The library runs without the GIL, so
+	Python threads may each run a solve at once.'''
+	text=header.strip()+'\n'+''.join(str(m)+'\n' for m in muls)
+	if rates!=None: text+=str(len(rates))+'\n'+''.join(str(r)+' '+str(x)+'\n' for r,x in rates)
+	iname='int'+str(threading.get_ident())+'.txt'
+	lines=runsolver(iname,text).split('\n')
+	a=lines[0].split()
+	return int(a[2]),int(a[1]),int(a[11]),int(a[12]),[int(l) for l in lines[1:1+int(a[0])]]
+
+def readschemes(fnames,trans=True):
+	'''Multiplications of each scheme file, read in one call to the C++ solver if there is one, else by loadsol.
+	The solver also reads the signed lifted form, taking coefficients mod 2.'''
+	if fastsolver!=None and len(fnames)>0:
+		r=subprocess.run([fastsolver,'--parse',str(matdim),str(rcorder),str(int(trans))]+fnames,capture_output=True,text=True)
+		if r.returncode==0:
+			lines=r.stdout.split('\n')
+			out=[]; i=0
+			while i<len(lines) and lines[i]!='':
+				count=int(lines[i].split()[-2])
+				out.append([[int(x) for x in l.split()[:3]] for l in lines[i+1:i+1+count]])
+				i+=count+1
+			return out
+		print('Solver could not read schemes:',r.stderr.strip())
+	out=[]
+	for fn in fnames:
+		mset=MultSet()
+		mset.loadsol(fn,trans)
+		out.append([m for m in mset.muls if m!=[0,0,0]])
+	return out
+
+def writeschemes(items,trans=True):
+	'''Write each (file name, multiplications) in items as a scheme file, in one call to the C++ solver if there
+	is one, else by writesol.'''
+	if fastsolver!=None and len(items)>0:
+		s=''.join(fn+' '+str(len(muls))+' 0\n'+''.join(str(m[0])+' '+str(m[1])+' '+str(m[2])+'\n' for m in muls) for fn,muls in items)
+		r=subprocess.run([fastsolver,'--write',str(matdim),str(rcorder),str(int(trans))],input=s,capture_output=True,text=True)
+		if r.returncode==0: return
+		print('Solver could not write schemes:',r.stderr.strip())
+	for fn,muls in items:
+		mset=MultSet()
+		mset.muls=muls; mset.nomuls=len(muls)
+		mset.writesol(fn,trans)
+
+def message(host,port,msg):
+	'''Send one JSON message to the campaign coordinator and return its reply.'''
+	with socket.create_connection((host,port),timeout=60) as c:
+		c.sendall((json.dumps(msg)+'\n').encode())
+		l=c.makefile('r').readline()
+	return json.loads(l)
+
+def worker(addr):
+	'''Take solves from a campaign coordinator at host:port, run them and report results until the campaign is done.'''
+	global fastsolver
+	host,port=addr.rsplit(':',1); port=int(port)
+	wid=socket.gethostname()+'-'+str(os.getpid())
+	if fastsolver!=None: fastsolver=os.path.abspath(fastsolver)
+	home=os.getcwd()
+	tries=0; runs=0
+	while True:
+		try: r=message(host,port,{'op':'get','worker':wid}); tries=0
+		except OSError:
+			tries+=1
+			if runs>0 or tries>30: break
+			time.sleep(2); continue
+		if 'done' in r: break
+		if 'wait' in r: time.sleep(r['wait']); continue
+		job=r['job']
+
+		# Run the solve in a scratch folder holding the run case and any starting scheme.
+		wdir=tempfile.mkdtemp(prefix='fgjob')
+		os.chdir(wdir)
+		with open('job.txt','w') as f: f.write(job['case'])
+		os.mkdir('results')
+		if job['name']!=None: setsize(job['size']); schemes().add(job['muls'],len(job['muls']),job['name'])
+		stop=threading.Event()
+		def renew():
+			while not stop.wait(job['lease']/3):
+				try: message(host,port,{'op':'renew','worker':wid,'run':job['run']})
+				except OSError: pass
+		t=threading.Thread(target=renew,daemon=True); t.start()
+		ctrls[0]=job['run']-1; ctrls[16]=0
+		savedhashes.clear()
+		try: inputfile('job.txt')
+		finally:
+			stop.set(); t.join()
+			os.chdir(home)
+
+		# Report the outcome and the scheme saved, if any.
+		a={'op':'put','worker':wid,'run':job['run'],'best':None,'st':'No result returned - ','name':None,'muls':None}
+		if ctrls[16]!=0: a['best'],a['st']=ctrls[16]
+		js=SchemeStore(wdir+'/results')
+		for e in js.live.get((matdim,-1),[]):
+			x=js.muls(e)
+			if job['name']==None or x!=job['muls']: a['name']=js.name(e); a['muls']=x
+		js.close()
+		if store!=None: store.close()
+		shutil.rmtree(wdir,ignore_errors=True)
+		try: message(host,port,a)
+		except OSError: print('Coordinator not reachable, result of run',job['run'],'lost.')
+		runs+=1
+	if ctrls[7]>=0: print('Worker',wid,'finished after',runs,'runs.')
+
+class Campaign:
+	'''Coordinator handing out the solves of a run case to workers over TCP.
+	Each solve is leased to one worker and handed out again if the lease is not renewed in time.  Workers
+	send back the scheme they saved, which is kept in the coordinator's scheme store, so continuation
+	runs take their starting schemes from everything found so far across all workers.'''
+
+	def __init__(self,iname):
+		'''Read the run case and set up the solves.'''
+		with open(iname,'r') as f: self.case=f.readlines()
+		self.solves=1; rseed=-1; self.rt=0; self.fname=None; self.start=0; self.lease=3600; n=4
+		for l in self.case:
+			a=l.split()
+			if len(a)>1 and a[0]!='#':
+				if a[0]=='MATRIX_SIZE:': n=int(a[1])
+				if a[0]=='NUMBER_OF_SOLVES:': self.solves=int(a[1])
+				if a[0]=='RANDOM_SEED:' and a[1]!='AUTO': rseed=int(a[1])
+				if a[0]=='RUN_TYPE:' and a[1]=='CONTINUATION': self.rt=1
+				if a[0]=='SAVED_FILE:': self.fname=a[1]
+				if a[0]=='SAVED_SIZE:':
+					if a[1]=='RANDOM': self.start=-1
+					else: self.start=int(a[1])
+				if a[0]=='LEASE_TIME:': self.lease=int(a[1])
+				if a[0]=='PRINT_OUTPUT:' and a[1]=='NONE': ctrls[7]=-1
+				if a[0]=='WRITE_LOG:' and a[1]=='NO': ctrls[8]=0
+		if rseed==-1: rseed=int(1000000*time.time()+1000000*os.getpid())%10000000000
+		ctrls[3]=rseed
+		random.seed(rseed)
+		setsize(n)
+		ctrls[11]=[0]*1000
+		self.state=[0]*(self.solves+1)		# 0 waiting, 1 leased, 2 finished.
+		self.deadline=[0]*(self.solves+1)
+		self.holder=[None]*(self.solves+1)
+		self.started=[None]*(self.solves+1)
+		self.finished=0
+		self.lock=threading.Lock()
+		self.done=threading.Event()
+
+	def jobcase(self,r,name):
+		'''Run case for a single solve, with its own seed, no log, no lifting, which the coordinator does, and any
+		starting scheme.'''
+		seed=(ctrls[3]+r*2654435761)%10000000000
+		rep={'NUMBER_OF_SOLVES:':'1','RANDOM_SEED:':str(seed),'WRITE_LOG:':'NO'}
+		s=''
+		for l in self.case:
+			a=l.split()
+			if len(a)>0 and a[0] in rep: s+=a[0]+' '+rep[a[0]]+'\n'
+			elif len(a)>0 and a[0] in ('SAVED_FILE:','SAVED_SIZE:','ARM:','LIFT:'): pass
+			else: s+=l
+		if name!=None: s+='\nSAVED_FILE: '+name+'\n'
+		return s
+
+	def choose(self):
+		'''Choose a starting scheme from the scheme store for a continuation solve.'''
+		if self.fname!=None: e=schemes().find(self.fname)
+		else: e=schemes().choose(self.start)
+		if e==None: return None,None
+		return schemes().name(e),schemes().muls(e)
+
+	def handle(self,r):
+		'''Answer one worker message.'''
+		now=time.time()
+		if r['op']=='get':
+			for i in range(1,self.solves+1):
+				if self.state[i]==1 and self.deadline[i]<now: self.state[i]=0
+			for i in range(1,self.solves+1):
+				if self.state[i]==0:
+					name,muls=None,None
+					if self.rt==1:
+						name,muls=self.choose()
+						if name==None: print('No saved solutions to continue from.'); self.done.set(); return {'done':True}
+					self.state[i]=1; self.deadline[i]=now+self.lease; self.holder[i]=r['worker']; self.started[i]=name
+					return {'job':{'run':i,'case':self.jobcase(i,name),'name':name,'muls':muls,'size':matdim,'lease':self.lease}}
+			if self.finished==self.solves: return {'done':True}
+			return {'wait':5}
+		i=r['run']
+		if r['op']=='renew':
+			if self.state[i]!=1 or self.holder[i]!=r['worker']: return {'ok':False}
+			self.deadline[i]=now+self.lease
+			return {'ok':True}
+		if r['op']=='put':
+			if self.state[i]==2: return {'ok':False}
+			self.state[i]=2; self.finished+=1
+			self.collect(i,r)
+			if self.finished==self.solves: self.done.set()
+			return {'ok':True}
+		return {'error':'unknown op'}
+
+	def collect(self,i,r):
+		'''Record the outcome of a solve and keep the scheme it saved.'''
+		best=r['best']; st=r['st']
+		if r['muls']!=None:
+			# Check the scheme against the answer before keeping it, as anything can be sent to the port.
+			mset=MultSet()
+			mset.muls=[m for m in r['muls'] if m!=[0,0,0]]; mset.nomuls=len(mset.muls)
+			mset.evalall()
+			if mset.err>0 or mset.nomuls!=best:
+				if ctrls[7]>=0: print('Scheme from worker',r['worker'],'failed check, not saved.')
+				r['muls']=None; best=None
+		if best!=None: ctrls[11][best]+=1
+		if r['muls']!=None:
+			hkey=None
+			if 'Hash: ' in st: hkey=(st.split('Hash: ')[1].split()[0],best)
+			if hkey==None or hkey not in savedhashes:
+				if hkey!=None: savedhashes.add(hkey)
+				if self.started[i]!=None and r['name']==self.started[i]: liftsaved(schemes().add(r['muls'],best,r['name']))
+				else: liftsaved(schemes().add(r['muls'],best))
+		s=str(ctrls[3]).zfill(10)+'/'+str(i).zfill(3)
+		if self.started[i]!=None: s+=' From: '+self.started[i]
+		s+=' Best: '+str(best)+' '+st+' Worker: '+r['worker']
+		if ctrls[7]>=0: print(s[11:])
+		if ctrls[8]==1:
+			with open('runlog.txt','a') as f: f.write(s+'\n')
+
+	def serve(self,addr):
+		'''Serve workers on [host:]port until every solve has finished, on 127.0.0.1 unless a host is given.'''
+		host='127.0.0.1'
+		if ':' in addr: host,addr=addr.rsplit(':',1)
+		campaign=self
+		class Handler(socketserver.StreamRequestHandler):
+			def handle(self):
+				r=json.loads(self.rfile.readline())
+				with campaign.lock: a=campaign.handle(r)
+				self.wfile.write((json.dumps(a)+'\n').encode())
+		socketserver.ThreadingTCPServer.allow_reuse_address=True
+		server=socketserver.ThreadingTCPServer((host,int(addr)),Handler)
+		threading.Thread(target=server.serve_forever,daemon=True).start()
+		if ctrls[7]>=0: print('Coordinator for',self.solves,'solves on port',addr,'- random number seed:',ctrls[3])
+		if ctrls[8]==1:
+			with open('runlog.txt','a') as f:
+				nowstr=datetime.datetime.now().strftime('%d/%m/%Y %H:%M:%S')
+				f.write(str(ctrls[3]).zfill(10)+' Run at: '+nowstr+' Campaign of '+str(self.solves)+' solves on port '+str(addr)+'\n')
+		self.done.wait()
+		time.sleep(10)
+		server.shutdown()
+		s='Summary:'
+		for i in range(1000):
+			if ctrls[11][i]>0: s+=' '+str(i)+'/'+str(ctrls[11][i])
+		if ctrls[7]>=0: print(s)
+		if ctrls[8]==1:
+			with open('runlog.txt','a') as f: f.write(str(ctrls[3]).zfill(10)+' '+s+'\n')
+
 class MultSet:
 	'''Object representing a set of multiplications.'''
 	# Version 7.10:
@@ -559,6 +1387,7 @@ class MultSet:
 		self.maxplus=0
 		self.muls=[]
 		self.ring=None
+		self.hash=None
 
 		# Load scheme from file.
 		if fname!=None:
@@ -574,6 +1403,7 @@ class MultSet:
 					self.muls.append(m)
 					self.nomuls+=1
 			self.flips=orig.flips
+			self.hash=orig.hash
 			self.evalall()
 
 		# Define scheme from pattern representing current error, with symmetry option.
@@ -700,33 +1530,72 @@ class MultSet:
 		split=ctrls[4]
 		if target<0: target=self.nomuls+target
 		rseed=random.randrange(1000000000)
-		iname='int'+str(ctrls[3]).zfill(10)+'.txt'
-		with open(iname,'w') as f:
-			s=str(self.nomuls)+' '+str(self.flips)+' '+str(rcode)+' '+str(target)+' '+str(flimit)+' '
-			s+=str(plimit)+' '+str(termination)+' '+str(rseed)+' '+str(symm)+' '+str(self.maxplus)+' '
-			s+=str(split)+' '+str(self.nomuls)+' '+str(maxsize)+'\n'
-			f.write(s)
-			for m in self.muls: s=str(m[0])+'\n'; f.write(s)
-		if fastsolver==None: flipsolver(iname)
-		else: subprocess.run([fastsolver,iname])
-		with open(iname,'r') as f:
-			l=f.readline()
+		rname='results/rates-'+str(matdim)+'-'+str(symm)+'-'+str(cubes)+'.txt'
+		iname='int'+str(ctrls[3]).zfill(10)+'-'+str(ctrls[0]).zfill(3)+'.txt'
+		s=str(self.nomuls)+' '+str(self.flips)+' '+str(rcode)+' '+str(target)+' '+str(flimit)+' '
+		s+=str(plimit)+' '+str(termination)+' '+str(rseed)+' '+str(symm)+' '+str(self.maxplus)+' '
+		s+=str(split)+' '+str(self.nomuls)+' '+str(maxsize)+' '+str(ctrls[21])+' '+str(ctrls[22])+' '+str(ctrls[23])+' '+str(ctrls[24])+' '+str(ctrls[25])+' '+str(ctrls[26])+' '+str(ctrls[27])+' '+ctrls[28]+' '+str(ctrls[29])+' '+str(ctrls[30])
+		if ctrls[31]==1: s+=' '+str(ctrls[3])+' '+str(ctrls[0])
+		else: s+=' -1 '+str(ctrls[0])
+		if ctrls[33]>=0: s+=' '+str(ctrls[32])+' '+str(ctrls[33]+getattr(solveslot,'k',0)*solvecpus())
+		else: s+=' '+str(ctrls[32])+' -1'
+		if ctrls[34]>0: s+=' '+str(ctrls[34]-cubes)+' '+str(ctrls[35])
+		else: s+=' 0 0'
+		s+=' '+str(ctrls[36])+' '+str(ctrls[37])+' '+str(max(ctrls[38],0))
+		mname=ctrls[41]
+		if ctrls[40]<=0: mname='-'
+		elif inflight>1:
+			root,ext=os.path.splitext(mname)
+			mname=root+'-'+str(getattr(solveslot,'k',0))+ext
+		flight='-'
+		if ctrls[43]!='-':
+			root,ext=os.path.splitext(ctrls[43])
+			flight=root+'-'+str(ctrls[3]).zfill(10)+'-'+str(ctrls[0]).zfill(3)+ext
+		s+=' '+str(ctrls[40])+' '+mname+' '+str(ctrls[42])+' '+flight+'\n'
+		s+=''.join(str(m[0])+'\n' for m in self.muls)
+		if ctrls[38]>0:
+			runs,model=loadrates(rname)
+			if runs>=10:
+				top=max(model)
+				s+=str(top-target)+'\n'
+				for r in range(target+1,top+1):
+					if r in model: s+=str(r)+' '+str((model[r][1]+1)/(model[r][2]+flimit))+'\n'
+					else: s+=str(r)+' '+str(1/flimit)+'\n'
+		lines=iter(runsolver(iname,s).split('\n'))
+		l=next(lines,'')
+		a=l.split()
+		self.flips=int(a[1]); rcode=int(a[2]); achieved=int(a[10]); minmuls=int(a[11]); plus=int(a[12])
+		reductions=-1; greedy=0
+		if len(a)>14: reductions=int(a[13]); greedy=int(a[14])
+		if len(a)>15: self.hash=int(a[15])
+		swaps=0; branches=0
+		if len(a)>16: swaps=int(a[16])
+		if len(a)>17: branches=int(a[17])
+		muls=[]
+		for i in range(self.nomuls):
+			l=next(lines,'')
 			a=l.split()
-			self.flips=int(a[1]); rcode=int(a[2]); achieved=int(a[10]); minmuls=int(a[11]); plus=int(a[12])
-			muls=[]
-			for i in range(self.nomuls):
-				l=f.readline()
-				a=l.split()
-				muls.append(int(a[0]))
-			fullmuls=[]
-			me=[0]*self.nomuls; mf=[0]*self.nomuls
-			for i in range(0,self.nomuls,3):
-				me[i]=i+2; mf[i]=i+1
-				me[i+1]=i; mf[i+1]=i+2
-				me[i+2]=i+1; mf[i+2]=i
-			for i in range(len(muls)): fullmuls.append([muls[i],muls[me[i]],muls[mf[i]]])
-			self.muls=fullmuls
-		os.remove(iname)
+			muls.append(int(a[0]))
+		reach=next(lines,'').split()
+		if ctrls[38]>=0 and len(reach)>=3:
+			# Add this walk's time at each rank it reached, and whether it reduced from there, to the model.
+			runs,model=loadrates(rname)
+			start=int(reach[0]); n=int(reach[1])
+			for i in range(n):
+				r=start-i*symm
+				if r not in model: model[r]=[0,0,0]
+				model[r][0]+=1
+				if i+1<n: model[r][1]+=1; model[r][2]+=int(reach[i+3])-int(reach[i+2])
+				else: model[r][2]+=self.flips-int(reach[i+2])
+			saverates(rname,runs+1,model)
+		fullmuls=[]
+		me=[0]*self.nomuls; mf=[0]*self.nomuls
+		for i in range(0,self.nomuls,3):
+			me[i]=i+2; mf[i]=i+1
+			me[i+1]=i; mf[i+1]=i+2
+			me[i+2]=i+1; mf[i+2]=i
+		for i in range(len(muls)): fullmuls.append([muls[i],muls[me[i]],muls[mf[i]]])
+		self.muls=fullmuls
 		tt=time.time()-tt
 		if tt>0: spstr=f'{int(60*(self.flips)/tt/1000000)}'
 		else: spstr='N/A'
@@ -741,10 +1610,16 @@ class MultSet:
 		if rcode==4: st='Not implemented - '
 		if rcode==5: st='Divergence detected - '
 		if rcode==6: st='Escaped infinite loop - '
+		if rcode==7: st='Interrupted - '
+		if rcode==8: st='Time limit reached - '
 		if rcode==9: st='No result returned - '
 		if rcode==-1 and achieved==target: rcode=0
 		self.evalall()
 		st+='Flips: '+str(self.flips)+' Speed: '+spstr+' megaflips/min'
+		if reductions>=0 and ctrls[23]>0: st+=' Reductions: '+str(reductions)+' Greedy: '+str(greedy)
+		if swaps>0: st+=' Swaps: '+str(swaps)
+		if branches>0: st+=' Branches: '+str(branches)
+		if self.hash!=None: st+=' Hash: '+format(self.hash,'016x')
 		return rcode,minmuls,st
 
 	def evalall(self):
@@ -1529,8 +2404,22 @@ def plotbar(v,x,s=''):
 	plt.ylim([ymin,ymax])
 	plt.show()	
 
+def setsize(n):
+	'''Set global size data for n x n matrices, in the order used throughout, and the answer.'''
+	global matdim,matsize,matvecs,row,col,odr
+	matdim=n
+	matsize=matdim*matdim
+	matvecs=2**matsize
+	row=[[0]*matsize for i in range(3)]
+	col=[[0]*matsize for i in range(3)]
+	odr=[[0]*matsize for i in range(3)]
+	setrco(1)
+	answer()
+
 def setrco(order):
 	'''Set global row, col and ord variables, defining reordering of A,B and C.'''
+	global rcorder
+	rcorder=order
 	if order==0: # Normal row/column order.
 		for i in range(3):
 			for j in range(matsize): row[i][j]=j//matdim; col[i][j]=j%matdim